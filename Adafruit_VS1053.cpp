@@ -29,26 +29,90 @@
 #define digitalPinToInterrupt(x) x
 #endif
 
-static Adafruit_VS1053_FilePlayer *myself;
+// Players fed from the timer/DREQ interrupts set up by useInterrupt()
+static Adafruit_VS1053_FilePlayer *volatile players[VS1053_MAX_PLAYERS];
+static volatile uint8_t numPlayers = 0;
 
-#ifndef _BV
-#define _BV(x) (1 << (x)) //!< Macro that returns the "value" of a bit
+#if (VS1053_FILEBUFFERLEN & (VS1053_FILEBUFFERLEN - 1)) ||                     \
+    (VS1053_FILEBUFFERLEN < VS1053_DATABUFFERLEN)
+#error "VS1053_FILEBUFFERLEN must be a power of 2, >= VS1053_DATABUFFERLEN"
 #endif
 
-#if defined(ARDUINO_ARCH_AVR)
-SIGNAL(TIMER0_COMPA_vect) { myself->feedBuffer(); }
+// SD reads are done in whole sectors, or half the buffer if that's smaller
+#if (VS1053_FILEBUFFERLEN / 2) < VS1053_SECTORLEN
+#define VS1053_FILEREADLEN (VS1053_FILEBUFFERLEN / 2)
+#else
+#define VS1053_FILEREADLEN VS1053_SECTORLEN
 #endif
 
-volatile boolean feedBufferLock = false; //!< Locks feeding the buffer
-boolean _loopPlayback; //!< internal variable, used to control playback looping
+// Recordings are opened without O_APPEND, so the WAV header can be patched
+#if defined(ESP32)
+#define VS1053_FILE_UPDATE FILE_WRITE
+#elif defined(ESP8266)
+#define VS1053_FILE_UPDATE (sdfat::O_READ | sdfat::O_WRITE | sdfat::O_CREAT)
+#else
+#define VS1053_FILE_UPDATE (O_READ | O_WRITE | O_CREAT)
+#endif
+
+// Adafruit_VS1053_FilePlayer::_recordState
+enum {
+  VS1053_REC_IDLE,
+  VS1053_REC_RUNNING,
+  VS1053_REC_STOPPING, // waiting for the encoder to finish
+  VS1053_REC_DRAINED   // all the data is in the ring
+};
+
+#ifndef _BV
+#define _BV(x) (1 << (x)) //!< Macro that returns the "value" of a bit
+#endif
 
 #if defined(ESP8266)
 ICACHE_RAM_ATTR
 #endif
-static void feeder(void) { myself->feedBuffer(); }
+static void feeder(void) {
+  // each player checks its own DREQ and lock, so it's fine to feed them all
+  for (uint8_t i = 0; i < numPlayers; i++)
+    players[i]->feedBuffer();
+}
+
+#if defined(ARDUINO_ARCH_AVR)
+SIGNAL(TIMER0_COMPA_vect) { feeder(); }
+#endif
+
+static boolean addPlayer(Adafruit_VS1053_FilePlayer *player) {
+  for (uint8_t i = 0; i < numPlayers; i++) {
+    if (players[i] == player)
+      return true;
+  }
+  if (numPlayers == VS1053_MAX_PLAYERS)
+    return false;
+  // store the pointer before the count so the ISR never sees a NULL
+  players[numPlayers] = player;
+  numPlayers = numPlayers + 1;
+  return true;
+}
+
+static void removePlayer(Adafruit_VS1053_FilePlayer *player) {
+  noInterrupts();
+  for (uint8_t i = 0; i < numPlayers; i++) {
+    if (players[i] == player) {
+      players[i] = players[numPlayers - 1];
+      numPlayers = numPlayers - 1;
+      break;
+    }
+  }
+  interrupts();
+}
+
+// called when an async SDI transfer finishes, DREQ may already be high again
+// so don't wait for the next edge
+static void transportFeeder(void *player) {
+  ((Adafruit_VS1053_FilePlayer *)player)->feedBuffer();
+}
 
 boolean Adafruit_VS1053_FilePlayer::useInterrupt(uint8_t type) {
-  myself = this; // oy vey
+  if (!addPlayer(this))
+    return false;
 
   usingInterrupts = true;
 
@@ -58,8 +122,13 @@ boolean Adafruit_VS1053_FilePlayer::useInterrupt(uint8_t type) {
     TIMSK0 |= _BV(OCIE0A);
     return true;
 #elif defined(__arm__) && defined(CORE_TEENSY)
-    IntervalTimer *t = new IntervalTimer();
-    return (t && t->begin(feeder, 1024)) ? true : false;
+    // one timer feeds every player
+    static IntervalTimer *t = NULL;
+    if (t)
+      return true;
+    t = new IntervalTimer();
+    if (t && t->begin(feeder, 1024))
+      return true;
 #elif defined(ARDUINO_STM32_FEATHER)
     HardwareTimer timer(3);
     // Pause the timer while we're configuring it
@@ -81,14 +150,18 @@ boolean Adafruit_VS1053_FilePlayer::useInterrupt(uint8_t type) {
 
 #else
     usingInterrupts = false;
+    removePlayer(this);
     return false;
 #endif
   }
   if (type == VS1053_FILEPLAYER_PIN_INT) {
     int8_t irq = digitalPinToInterrupt(_dreq);
     // Serial.print("Using IRQ "); Serial.println(irq);
-    if (irq == -1)
+    if (irq == -1) {
+      usingInterrupts = false;
+      removePlayer(this);
       return false;
+    }
 #if defined(SPI_HAS_TRANSACTION) && !defined(ESP8266) && !defined(ESP32) &&    \
     !defined(ARDUINO_STM32_FEATHER)
     SPI.usingInterrupt(irq);
@@ -97,27 +170,22 @@ boolean Adafruit_VS1053_FilePlayer::useInterrupt(uint8_t type) {
     return true;
   }
   usingInterrupts = false;
+  removePlayer(this);
   return false;
 }
 
 Adafruit_VS1053_FilePlayer::Adafruit_VS1053_FilePlayer(int8_t rst, int8_t cs,
                                                        int8_t dcs, int8_t dreq,
                                                        int8_t cardcs)
-    : Adafruit_VS1053(rst, cs, dcs, dreq) {
-
-  playingMusic = false;
-  _cardCS = cardcs;
-  _loopPlayback = false;
+    : Adafruit_VS1053(rst, cs, dcs, dreq), _fileSource(currentTrack) {
+  init(cardcs);
 }
 
 Adafruit_VS1053_FilePlayer::Adafruit_VS1053_FilePlayer(int8_t cs, int8_t dcs,
                                                        int8_t dreq,
                                                        int8_t cardcs)
-    : Adafruit_VS1053(-1, cs, dcs, dreq) {
-
-  playingMusic = false;
-  _cardCS = cardcs;
-  _loopPlayback = false;
+    : Adafruit_VS1053(-1, cs, dcs, dreq), _fileSource(currentTrack) {
+  init(cardcs);
 }
 
 Adafruit_VS1053_FilePlayer::Adafruit_VS1053_FilePlayer(int8_t mosi, int8_t miso,
@@ -125,11 +193,50 @@ Adafruit_VS1053_FilePlayer::Adafruit_VS1053_FilePlayer(int8_t mosi, int8_t miso,
                                                        int8_t cs, int8_t dcs,
                                                        int8_t dreq,
                                                        int8_t cardcs)
-    : Adafruit_VS1053(mosi, miso, clk, rst, cs, dcs, dreq) {
+    : Adafruit_VS1053(mosi, miso, clk, rst, cs, dcs, dreq),
+      _fileSource(currentTrack) {
+  init(cardcs);
+}
 
+// Everything the three constructors share
+void Adafruit_VS1053_FilePlayer::init(int8_t cardcs) {
   playingMusic = false;
   _cardCS = cardcs;
+  _source = NULL;
+  _sourceStart = 0;
+  _format = VS1053_FORMAT_UNKNOWN;
+  _blockAlign = 0;
+  _playState = VS1053_STATE_STOPPED;
+  _asyncTrack = NULL;
+  _cancelling = false;
+  _drainLeft = 0;
+  _cancelLeft = 0;
+  _endFillByte = 0;
+  _resetPending = false;
+  _resetting = false;
+  _trackStarted = NULL;
+  _trackEnded = NULL;
+  _queuedTrack = NULL;
+  _nextOpen = false;
+  _trackSwitched = false;
+  _vbrChecked = false;
+  _seekIndex = false;
+  _indexRecording = false;
+  _nextIndexName[0] = 0;
   _loopPlayback = false;
+  _burstFeed = false;
+  _deferReads = false;
+  _feedBufferLock = false;
+  _feedPending = false;
+  memset(&_stats, 0, sizeof(_stats));
+  _mixStart = 0;
+  _promptLeft = 0;
+  _duckGain = 0x10000;
+  setDucking(64, 50);
+  _fading = false;
+  _recordState = VS1053_REC_IDLE;
+  memset(&_recordStats, 0, sizeof(_recordStats));
+  resetFileBuffer();
 }
 
 boolean Adafruit_VS1053_FilePlayer::begin(void) {
@@ -158,28 +265,96 @@ boolean Adafruit_VS1053_FilePlayer::playFullFile(const char *trackname) {
 }
 
 void Adafruit_VS1053_FilePlayer::stopPlaying(void) {
+  // stop feeding first so the interrupt doesn't race us for the bus
+  playingMusic = false;
+  waitForTransport();
+
+  // forget the queued track, the cancel mustn't run on into it
+  if (_nextOpen)
+    _nextTrack.close();
+  _nextOpen = false;
+  _queuedTrack = NULL;
+
   // cancel all playback
-  sciWrite(VS1053_REG_MODE, VS1053_MODE_SM_LINE1 | VS1053_MODE_SM_SDINEW |
-                                VS1053_MODE_SM_CANCEL);
+  cancelDecoding();
+  _resetPending = false; // it's been done if it was needed
+  _resetting = false;
 
   // wrap it up!
-  playingMusic = false;
-  currentTrack.close();
+  if (_source)
+    closeSource();
+  resetFileBuffer();
+  closeSeekIndex();
+  _playState = VS1053_STATE_STOPPED;
+}
+
+// The feeder's cancel sequence, see endOfTrack(), run to the end from here
+void Adafruit_VS1053_FilePlayer::cancelDecoding(void) {
+  startCancel();
+  while (_finishing) {
+    while (!readyForData())
+      ;
+    endOfTrack();
+  }
+  if (_resetPending)
+    softReset();
+}
+
+// Datasheet 'Cancelling playback': set SM_CANCEL, then endOfTrack() keeps
+// sending the track until the decoder clears it
+void Adafruit_VS1053_FilePlayer::startCancel(void) {
+  holdBus();
+  // the last block handed to the transport is out now
+  _fileBufferTail += _transferLen;
+  _transferLen = 0;
+  sciWrite(VS1053_REG_MODE,
+           sciReadCached(VS1053_REG_MODE) | VS1053_MODE_SM_CANCEL);
+  _drainLeft = 0;
+  _cancelLeft = VS1053_CANCELLEN;
+  _cancelling = true;
+  _finishing = true;
+  interrupts();
+}
+
+// Up to 32 bytes of the track while cancelling. If it runs out first,
+// endFillByte stands in for it, as at the end of a file
+uint8_t Adafruit_VS1053_FilePlayer::sendCancelData(void) {
+  if (_source && !_deferReads)
+    fillFileBuffer();
+
+  uint16_t buffered = _fileBufferHead - _fileBufferTail;
+  if (buffered) {
+    uint16_t tail = _fileBufferTail & (VS1053_FILEBUFFERLEN - 1);
+    uint16_t len = VS1053_FILEBUFFERLEN - tail;
+    if (len > buffered)
+      len = buffered;
+    if (len > VS1053_DATABUFFERLEN)
+      len = VS1053_DATABUFFERLEN;
+    playData(_fileBuffer + tail, len);
+    _fileBufferTail += len;
+    return len;
+  }
+
+  uint8_t fill[VS1053_DATABUFFERLEN];
+  memset(fill, endFillByte(), sizeof(fill));
+  playData(fill, sizeof(fill));
+  return sizeof(fill);
 }
 
 void Adafruit_VS1053_FilePlayer::pausePlaying(boolean pause) {
-  playingMusic = (!pause && currentTrack);
+  _lastFeed = 0; // don't count the time spent paused
+  playingMusic = (!pause && _source);
   if (playingMusic) {
     feedBuffer();
   }
 }
 
 boolean Adafruit_VS1053_FilePlayer::paused(void) {
-  return (!playingMusic && currentTrack);
+  return (!playingMusic && _source);
 }
 
 boolean Adafruit_VS1053_FilePlayer::stopped(void) {
-  return (!playingMusic && !currentTrack);
+  return (!playingMusic && !_source);
 }
 
 void Adafruit_VS1053_FilePlayer::playbackLoop(boolean loopState) {
@@ -188,169 +363,2267 @@ void Adafruit_VS1053_FilePlayer::playbackLoop(boolean loopState) {
 
 boolean Adafruit_VS1053_FilePlayer::playbackLooped() { return _loopPlayback; }
 
+void Adafruit_VS1053_FilePlayer::burstFeed(boolean burstState) {
+  _burstFeed = burstState;
+}
+
+boolean Adafruit_VS1053_FilePlayer::burstFeeding() { return _burstFeed; }
+
+void Adafruit_VS1053_FilePlayer::deferReads(boolean deferState) {
+  _deferReads = deferState;
+}
+
+boolean Adafruit_VS1053_FilePlayer::readsDeferred() { return _deferReads; }
+
+void Adafruit_VS1053_FilePlayer::fillBuffer(void) {
+  if (!_source)
+    return;
+
+  if (!playingMusic) {
+    // the feeder ran out at the end of the track, tidy up for it
+    if (_fileEOF && (_fileBufferHead == _fileBufferTail))
+      closeSource();
+    return;
+  }
+
+  // the card shares the bus, keep the feeder (and any transfer it would
+  // start) off it while we read
+  if (!lockFeed())
+    return; // try again next time
+  waitForTransport();
+  fillFileBuffer();
+  // after an underrun DREQ stays high, so there's no edge coming to start
+  // the feeder again
+  feedBuffer_noLock();
+  unlockFeed();
+}
+
+boolean Adafruit_VS1053_FilePlayer::seekToByte(uint32_t pos) {
+  if (!_source)
+    return false;
+  // decodeTime() no longer matches the position, so stop indexing
+  _indexRecording = false;
+  return seekSource(pos);
+}
+
+boolean Adafruit_VS1053_FilePlayer::seekToMillis(uint32_t ms) {
+  if (!_source)
+    return false;
+
+  // hold off the feeder while we poke around in the source
+  boolean wasPlaying = playingMusic;
+  playingMusic = false;
+
+  uint32_t pos;
+  if (lookupSeekIndex(ms, &pos)) {
+    // the index was recorded while playing, it beats any estimate
+    playingMusic = wasPlaying;
+    if (!seekSource(alignToBlock(pos)))
+      return false;
+    holdBus();
+    sciWrite(VS1053_REG_DECODETIME, ms / 1000);
+    sciWrite(VS1053_REG_DECODETIME, ms / 1000);
+    interrupts();
+    return true;
+  }
+
+  if (!_vbrChecked)
+    readVBRHeader();
+
+  uint32_t offset;
+  if (_durationMs) {
+    // we know how long it is, so work from the VBR header
+    uint32_t bytes = _audioBytes;
+    if (!bytes && (_source->size() > _sourceStart))
+      bytes = _source->size() - _sourceStart;
+    if (ms > _durationMs)
+      ms = _durationMs;
+
+    if (_tocPos) {
+      // Xing TOC: 100 entries, entry n is the position at n% of the time
+      // as a fraction of 256, interpolate between two of them
+      uint32_t percent = ((uint64_t)ms * 10000) / _durationMs; // 1/100ths
+      uint8_t idx = (percent >= 9900) ? 99 : (percent / 100);
+      uint8_t toc[2] = {0, 0};
+      _source->seek(_tocPos + idx);
+      _source->read(toc, (idx < 99) ? 2 : 1);
+      uint16_t a = toc[0], b = (idx < 99) ? toc[1] : 256;
+      uint32_t frac = a * 100UL + (b - a) * (percent - idx * 100UL);
+      offset = ((uint64_t)bytes * frac) / 25600;
+    } else {
+      offset = ((uint64_t)bytes * ms) / _durationMs;
+    }
+  } else {
+    // fall back on the decoder's idea of the average byte rate
+    uint32_t rate = byteRate();
+    if (!rate) {
+      playingMusic = wasPlaying;
+      return false;
+    }
+    offset = ((uint64_t)rate * ms) / 1000;
+  }
+
+  // the byte rate counts audio data only, which comes after a WAV header
+  pos = _sourceStart + offset;
+  if (_blockAlign)
+    pos = alignToBlock(_blockStart + offset);
+
+  playingMusic = wasPlaying;
+  if (!seekSource(pos))
+    return false;
+
+  // As explained in datasheet, set twice to set the time. The feeder's
+  // running again, keep it off the bus in between
+  holdBus();
+  sciWrite(VS1053_REG_DECODETIME, ms / 1000);
+  sciWrite(VS1053_REG_DECODETIME, ms / 1000);
+  interrupts();
+  return true;
+}
+
+// Anywhere but the start of a WAV block (for PCM, a frame) decodes as noise
+// or with the channels swapped
+uint32_t Adafruit_VS1053_FilePlayer::alignToBlock(uint32_t pos) {
+  if (!_blockAlign || (pos < _blockStart))
+    return pos;
+  return pos - (pos - _blockStart) % _blockAlign;
+}
+
+boolean Adafruit_VS1053_FilePlayer::seekSource(uint32_t pos) {
+  // as in fillBuffer(), the feeder stays off the card and the ring until
+  // they're back in step
+  lockCard();
+  boolean wasPlaying = playingMusic;
+  playingMusic = false;
+
+  // anything still in the read-ahead buffer is from the old position
+  resetFileBuffer();
+  boolean ok = _source->seek(pos);
+  _mixPos = pos;
+  if (ok && wasPlaying)
+    fillFileBuffer();
+
+  playingMusic = wasPlaying;
+  if (ok && wasPlaying) {
+    // get data to the decoder right away rather than wait for an IRQ
+    feedBuffer_noLock();
+  }
+  unlockFeed();
+  return ok;
+}
+
+void Adafruit_VS1053_FilePlayer::seekIndex(boolean indexState) {
+  _seekIndex = indexState;
+}
+
+boolean Adafruit_VS1053_FilePlayer::seekIndexing() { return _seekIndex; }
+
+// "/dir/track001.mp3" -> "/dir/track001.idx", so it stays 8.3 friendly
+void Adafruit_VS1053_FilePlayer::seekIndexName(const char *trackname,
+                                               char *indexname) {
+  size_t len = strlen(trackname);
+  const char *dot = strrchr(trackname, '.');
+  const char *slash = strrchr(trackname, '/');
+  if (dot && (!slash || dot > slash))
+    len = dot - trackname;
+
+  if (len + 5 > VS1053_INDEXNAMELEN) {
+    indexname[0] = 0; // too long, don't index this one
+    return;
+  }
+  memcpy(indexname, trackname, len);
+  strcpy(indexname + len, ".idx");
+}
+
+// Seek indexes are read back and added to, so they're opened read/write
+// without truncating. On ESP32 FILE_WRITE truncates and can't be read, and
+// "r+" doesn't create the file
+static File openIndexFile(const char *indexname) {
+#if defined(ESP32)
+  return SD.open(indexname, SD.exists(indexname) ? "r+" : "w+");
+#else
+  return SD.open(indexname, VS1053_FILE_UPDATE);
+#endif
+}
+
+void Adafruit_VS1053_FilePlayer::openSeekIndex(const char *indexname) {
+  closeSeekIndex();
+  if (!indexname[0])
+    return;
+
+  lockCard();
+  _indexFile = openIndexFile(indexname);
+  if (_indexFile && !checkSeekIndex()) {
+    // made with a different interval, or cut short, start again
+    _indexFile.close();
+    SD.remove(indexname);
+    _indexFile = openIndexFile(indexname);
+    if (_indexFile && !checkSeekIndex())
+      _indexFile.close();
+  }
+  unlockFeed();
+
+  _indexRecording = _indexFile;
+  _indexChecked = 0;
+  _indexLastTime = 0xFFFF;
+}
+
+// With the card locked, make sure the index has a header we can use. An
+// empty file is given one
+boolean Adafruit_VS1053_FilePlayer::checkSeekIndex(void) {
+  // 8 byte header: "VSIX", the interval in seconds, 2 spare bytes
+  uint8_t header[8];
+  uint32_t size = _indexFile.size();
+  if (size >= sizeof(header)) {
+    _indexFile.seek(0);
+    return (_indexFile.read(header, sizeof(header)) == sizeof(header)) &&
+           !memcmp(header, "VSIX", 4) &&
+           (header[4] == VS1053_SEEKINDEX_INTERVAL);
+  }
+  if (size)
+    return false;
+
+  memcpy(header, "VSIX", 4);
+  header[4] = VS1053_SEEKINDEX_INTERVAL;
+  header[5] = header[6] = header[7] = 0;
+  _indexFile.seek(0);
+  if (_indexFile.write(header, sizeof(header)) != sizeof(header))
+    return false;
+  _indexFile.flush();
+  return true;
+}
+
+void Adafruit_VS1053_FilePlayer::closeSeekIndex(void) {
+  _indexRecording = false;
+  if (!_indexFile)
+    return;
+  lockCard();
+  _indexFile.close();
+  unlockFeed();
+}
+
+// The feeder may be reading the track from the same card, keep it (and any
+// transfer it would start) off the bus until unlockFeed()
+void Adafruit_VS1053_FilePlayer::lockCard(void) {
+  while (!lockFeed())
+    ;
+  waitForTransport();
+}
+
+void Adafruit_VS1053_FilePlayer::updateSeekIndex(void) {
+  if (!_indexRecording || !_indexFile || !playingMusic || _nextOpen)
+    return;
+
+  // decodeTime() only counts whole seconds, so look often enough to catch
+  // each one as it ticks over
+  if ((millis() - _indexChecked) < 50)
+    return;
+  _indexChecked = millis();
+
+  uint16_t t = decodeTime();
+  uint16_t last = _indexLastTime;
+  _indexLastTime = t;
+
+  lockCard();
+  uint32_t size = _indexFile.size();
+  uint32_t entries = (size >= 8) ? (size - 8) / 4 : 0;
+  // only just as the second it's for starts, any later and a seek to it
+  // lands late. The first entry is taken at the first look
+  if ((size >= 8) && (t == entries * VS1053_SEEKINDEX_INTERVAL) &&
+      (last == (uint16_t)(t - 1))) {
+    // what the decoder is on now is roughly what we've read less what's
+    // still waiting in the read-ahead buffer, and in the decoder's own
+    // FIFO. The feeder keeps that within 32 bytes of full. It's locked out
+    // now, so none of it moves meanwhile
+    uint32_t behind = (uint16_t)(_fileBufferHead - _fileBufferTail -
+                                 _transferLen) +
+                      (VS1053_FIFOLEN - VS1053_DATABUFFERLEN);
+    uint32_t pos = _source->position();
+    pos = (pos > _sourceStart + behind) ? (pos - behind) : _sourceStart;
+
+    uint8_t entry[4] = {uint8_t(pos), uint8_t(pos >> 8), uint8_t(pos >> 16),
+                        uint8_t(pos >> 24)};
+    // after the last whole entry, in case one was cut short
+    _indexFile.seek(8 + entries * 4);
+    _indexFile.write(entry, sizeof(entry));
+    _indexFile.flush();
+  }
+  // otherwise we already have it, or it's not the moment for it
+  unlockFeed();
+}
+
+boolean Adafruit_VS1053_FilePlayer::lookupSeekIndex(uint32_t ms,
+                                                    uint32_t *pos) {
+  if (!_indexFile)
+    return false;
+
+  // entries are evenly spaced, so go straight to the one we want
+  uint32_t interval = VS1053_SEEKINDEX_INTERVAL * 1000UL;
+  uint32_t n = ms / interval;
+  uint8_t entry[8];
+
+  lockCard();
+  uint32_t size = _indexFile.size();
+  uint32_t entries = (size >= 8) ? (size - 8) / 4 : 0;
+  boolean found = (n + 1 < entries) && _indexFile.seek(8 + n * 4) &&
+                  (_indexFile.read(entry, sizeof(entry)) == sizeof(entry));
+  unlockFeed();
+  if (!found)
+    return false; // not indexed that far yet
+
+  uint32_t a = entry[0] | ((uint32_t)entry[1] << 8) |
+               ((uint32_t)entry[2] << 16) | ((uint32_t)entry[3] << 24);
+  uint32_t b = entry[4] | ((uint32_t)entry[5] << 8) |
+               ((uint32_t)entry[6] << 16) | ((uint32_t)entry[7] << 24);
+  if (b < a)
+    return false;
+
+  *pos = a + ((uint64_t)(b - a) * (ms - n * interval)) / interval;
+  return true;
+}
+
+static uint32_t be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t le32(const uint8_t *p) {
+  return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[1] << 8) | p[0];
+}
+
+// RIFF fields are little endian
+static uint8_t *putLE(uint8_t *p, uint32_t value, uint8_t len) {
+  while (len--) {
+    *p++ = value;
+    value >>= 8;
+  }
+  return p;
+}
+
+// Build a WAV header for 16-bit PCM or VS1053 IMA ADPCM, returning its
+// length. A data length of 0xFFFFFFFF marks a stream of unknown length.
+static uint8_t wavHeader(uint8_t *header, boolean adpcm, uint8_t channels,
+                         uint32_t rate, uint32_t data) {
+  // 'fact' and the extra fmt fields are only for ADPCM
+  uint8_t *p = header;
+  uint16_t align, bits, fmtLen;
+  uint32_t byteRate;
+
+  if (adpcm) {
+    align = channels * VS1053_ADPCMBLOCKLEN;
+    bits = 4;
+    fmtLen = 20;
+    byteRate = rate * align / VS1053_ADPCMBLOCKSAMPLES;
+  } else {
+    align = channels * 2;
+    bits = 16;
+    fmtLen = 16;
+    byteRate = rate * align;
+  }
+  uint8_t len = adpcm ? VS1053_WAVHEADERMAX : 44;
+  uint32_t riff = data + (len - 8);
+  if (riff < data)
+    riff = 0xFFFFFFFF;
+
+  memcpy(p, "RIFF", 4);
+  p = putLE(p + 4, riff, 4);
+  memcpy(p, "WAVEfmt ", 8);
+  p = putLE(p + 8, fmtLen, 4);
+  p = putLE(p, adpcm ? 0x11 : 1, 2); // IMA ADPCM or PCM
+  p = putLE(p, channels, 2);
+  p = putLE(p, rate, 4);
+  p = putLE(p, byteRate, 4);
+  p = putLE(p, align, 2);
+  p = putLE(p, bits, 2);
+  if (adpcm) {
+    p = putLE(p, 2, 2); // extra fmt bytes
+    p = putLE(p, VS1053_ADPCMBLOCKSAMPLES, 2);
+    memcpy(p, "fact", 4);
+    p = putLE(p + 4, 4, 4);
+    p = putLE(p, data / align * VS1053_ADPCMBLOCKSAMPLES, 4);
+  }
+  memcpy(p, "data", 4);
+  putLE(p + 4, data, 4);
+  return len;
+}
+
+// ID3v2 sizes keep the top bit of each byte clear
+static uint32_t syncsafe(const uint8_t *p) {
+  return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) |
+         ((uint32_t)(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+// Length of an ID3v2 tag including its header and footer, or 0 if there
+// isn't one
+static uint32_t id3v2Length(const uint8_t *header) {
+  if (memcmp(header, "ID3", 3) || (header[3] == 0xFF) || (header[4] == 0xFF))
+    return 0;
+  return syncsafe(header + 6) + 10 + ((header[5] & 0x10) ? 10 : 0);
+}
+
+// Read exactly len bytes starting at pos
+static boolean readAt(Adafruit_VS1053_Source *source, uint32_t pos,
+                      uint8_t *buf, size_t len) {
+  if (!source->seek(pos))
+    return false;
+  while (len) {
+    int n = source->read(buf, len);
+    if (n <= 0)
+      return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+// Tell the format from the first 12 bytes of the audio
+static vs1053_format_t sniffFormat(const uint8_t *buf) {
+  if (!memcmp(buf, "OggS", 4))
+    return VS1053_FORMAT_OGG;
+  if (!memcmp(buf, "fLaC", 4))
+    return VS1053_FORMAT_FLAC;
+  if (!memcmp(buf, "RIFF", 4) && !memcmp(buf + 8, "WAVE", 4))
+    return VS1053_FORMAT_WAV;
+  if (!memcmp(buf, "MThd", 4))
+    return VS1053_FORMAT_MIDI;
+  if (!memcmp(buf + 4, "ftyp", 4))
+    return VS1053_FORMAT_MP4;
+  if ((buf[0] == 0xFF) && ((buf[1] & 0xE0) == 0xE0)) {
+    // ADTS has a 12 bit sync and layer 0, MPEG audio an 11 bit sync
+    uint8_t layer = (buf[1] >> 1) & 3;
+    if (layer)
+      return VS1053_FORMAT_MP3;
+    if ((buf[1] & 0xF0) == 0xF0)
+      return VS1053_FORMAT_AAC;
+  }
+  return VS1053_FORMAT_UNKNOWN;
+}
+
+// Decode an MPEG layer III frame header, the only layer the VBR headers
+// are found in. xing is where the Xing header would start in the frame
+static boolean mp3FrameInfo(const uint8_t *buf, uint32_t *rate,
+                            uint16_t *samplesPerFrame, uint8_t *xing,
+                            uint16_t *kbps) {
+  if ((buf[0] != 0xFF) || ((buf[1] & 0xE0) != 0xE0))
+    return false;
+  uint8_t version = (buf[1] >> 3) & 3; // 3 = MPEG1, 2 = MPEG2, 0 = MPEG2.5
+  uint8_t layer = (buf[1] >> 1) & 3;   // 1 = layer III
+  uint8_t bitrateIndex = buf[2] >> 4;
+  uint8_t rateIndex = (buf[2] >> 2) & 3;
+  boolean mono = ((buf[3] >> 6) & 3) == 3;
+  if ((version == 1) || (layer != 1) || (rateIndex == 3) ||
+      (bitrateIndex == 15))
+    return false;
+
+  static const uint16_t rates[] = {44100, 48000, 32000};
+  static const uint16_t mpeg1Kbps[] = {0,   32,  40,  48,  56,  64,
+                                       80,  96,  112, 128, 160, 192,
+                                       224, 256, 320};
+  static const uint16_t mpeg2Kbps[] = {0,  8,  16, 24,  32,  40,  48, 56,
+                                       64, 80, 96, 112, 128, 144, 160};
+  uint8_t shift = (version == 3) ? 0 : (version == 2) ? 1 : 2;
+  *rate = rates[rateIndex] >> shift;
+  *samplesPerFrame = (version == 3) ? 1152 : 576;
+  // the Xing header sits after the side info, which depends on the mode
+  *xing = (version == 3) ? (mono ? 21 : 36) : (mono ? 13 : 21);
+  *kbps = (version == 3) ? mpeg1Kbps[bitrateIndex] : mpeg2Kbps[bitrateIndex];
+  return true;
+}
+
+// Read the frame count and stream length from a Xing/Info or VBRI header,
+// 0 if missing. toc is set to the offset of the Xing TOC when there is one
+static void mp3VBRInfo(const uint8_t *buf, uint8_t xing, uint32_t *frames,
+                       uint32_t *bytes, uint8_t *toc) {
+  *frames = 0;
+  *bytes = 0;
+  *toc = 0;
+  if (!memcmp(buf + xing, "Xing", 4) || !memcmp(buf + xing, "Info", 4)) {
+    uint32_t flags = be32(buf + xing + 4);
+    const uint8_t *p = buf + xing + 8;
+    if (flags & 0x01) {
+      *frames = be32(p);
+      p += 4;
+    }
+    if (flags & 0x02) {
+      *bytes = be32(p);
+      p += 4;
+    }
+    if (flags & 0x04)
+      *toc = p - buf;
+  } else if (!memcmp(buf + 36, "VBRI", 4)) {
+    *bytes = be32(buf + 36 + 10);
+    *frames = be32(buf + 36 + 14);
+  }
+}
+
+void Adafruit_VS1053_FilePlayer::readVBRHeader(void) {
+  _vbrChecked = true;
+  _durationMs = 0;
+  _audioBytes = 0;
+  _tocPos = 0;
+
+  // first frame header plus room for a Xing or VBRI header after it
+  uint8_t buf[56];
+  uint32_t pos = _source->position();
+  if (!_source->seek(_sourceStart))
+    return;
+  int n = _source->read(buf, sizeof(buf));
+  _source->seek(pos);
+  if (n < (int)sizeof(buf))
+    return;
+
+  uint32_t rate, frames;
+  uint16_t samplesPerFrame, kbps;
+  uint8_t xing, toc;
+  if (!mp3FrameInfo(buf, &rate, &samplesPerFrame, &xing, &kbps))
+    return;
+  mp3VBRInfo(buf, xing, &frames, &_audioBytes, &toc);
+  if (toc)
+    _tocPos = _sourceStart + toc;
+  if (frames)
+    _durationMs = ((uint64_t)frames * samplesPerFrame * 1000) / rate;
+}
+
+void Adafruit_VS1053_FilePlayer::getFeedStats(vs1053_feedstats_t *stats) {
+  // the counters are updated from the interrupt, take a consistent copy
+  noInterrupts();
+  *stats = _stats;
+  interrupts();
+  stats->sciClock = sciClock();
+  stats->sdiClock = sdiClock();
+}
+
+void Adafruit_VS1053_FilePlayer::resetFeedStats(void) {
+  noInterrupts();
+  memset(&_stats, 0, sizeof(_stats));
+  interrupts();
+}
+
 // Just checks to see if the name ends in ".mp3"
 boolean Adafruit_VS1053_FilePlayer::isMP3File(const char *fileName) {
   return (strlen(fileName) > 4) &&
          !strcasecmp(fileName + strlen(fileName) - 4, ".mp3");
 }
 
-unsigned long Adafruit_VS1053_FilePlayer::mp3_ID3Jumper(File mp3) {
+unsigned long Adafruit_VS1053_FilePlayer::mp3_ID3Jumper(File mp3) {
+  uint8_t header[10];
+  uint32_t start = 0;
+
+  if (mp3) {
+    unsigned long current = mp3.position();
+    // the whole tag header in one read: "ID3", version, flags, size
+    if (mp3.seek(0) && (mp3.read(header, sizeof(header)) == sizeof(header)))
+      start = id3v2Length(header);
+    mp3.seek(current); // Put you things away like you found 'em.
+  }
+  return start;
+}
+
+vs1053_format_t
+Adafruit_VS1053_FilePlayer::detectFormat(Adafruit_VS1053_Source *source,
+                                         uint32_t *start) {
+  uint8_t buf[12];
+  vs1053_format_t format = VS1053_FORMAT_UNKNOWN;
+
+  *start = 0;
+  uint32_t pos = source->position();
+  if (!readAt(source, 0, buf, 10))
+    return format; // can't seek, nothing has been read
+
+  *start = id3v2Length(buf);
+  if (readAt(source, *start, buf, sizeof(buf)))
+    format = sniffFormat(buf);
+  // a tag is as good as a frame sync, the decoder finds the first frame
+  if (*start && (format == VS1053_FORMAT_UNKNOWN))
+    format = VS1053_FORMAT_MP3;
+  source->seek(pos);
+  return format;
+}
+
+vs1053_format_t Adafruit_VS1053_FilePlayer::trackFormat(void) {
+  return _format;
+}
+
+boolean Adafruit_VS1053_FilePlayer::startPlayingFile(const char *trackname) {
+  // the file buffer belongs to the recording until it's done
+  if (_recordState != VS1053_REC_IDLE)
+    return false;
+
+  // finish off anything still playing cleanly, so no reset is needed
+  if (_source)
+    stopPlaying();
+
+  uint32_t start;
+  if (!openTrack(trackname, &start))
+    return false;
+
+  return beginPlayback(&_fileSource, start);
+}
+
+boolean Adafruit_VS1053_FilePlayer::openTrack(const char *trackname,
+                                              uint32_t *start) {
+  currentTrack = SD.open(trackname);
+  if (!currentTrack) {
+    return false;
+  }
+
+  // We know we have a valid file. See what's in it, whatever it's called,
+  // and jump any ID3 tag
+  _format = detectFormat(&_fileSource, start);
+
+  if (_seekIndex) {
+    char indexname[VS1053_INDEXNAMELEN];
+    seekIndexName(trackname, indexname);
+    openSeekIndex(indexname);
+  }
+  return true;
+}
+
+void Adafruit_VS1053_FilePlayer::prepareSource(Adafruit_VS1053_Source *source,
+                                               uint32_t start) {
+  // the last track ended without the decoder letting go of SM_CANCEL
+  if (_resetPending)
+    softReset();
+  _resetPending = false;
+  _resetting = false;
+
+  // reset playback. Layer I/II decoding is left off for formats that
+  // aren't MPEG, so stray sync words in them can't set it off
+  uint16_t mode = VS1053_MODE_SM_LINE1 | VS1053_MODE_SM_SDINEW;
+  if ((_format == VS1053_FORMAT_MP3) || (_format == VS1053_FORMAT_UNKNOWN))
+    mode |= VS1053_MODE_SM_LAYER12;
+  sciWrite(VS1053_REG_MODE, mode);
+  // resync
+  wramWrite(0x1e29, 0);
+
+  resetFileBuffer();
+  if (sdiTransport)
+    sdiTransport->onComplete(transportFeeder, this);
+
+  // prompts can be mixed into 16-bit PCM, the header says where it is
+  _mixStart = 0;
+  _promptLeft = 0;
+  _duckGain = 0x10000;
+  _mixPos = start;
+  _blockAlign = 0;
+  if (_format == VS1053_FORMAT_WAV) {
+    vs1053_metadata_t meta;
+    boolean known = readMetadata(source, &meta);
+    if (known) {
+      _blockStart = meta.audioStart;
+      _blockAlign = meta.blockAlign;
+    }
+    if (known && (meta.bitsPerSample == 16) &&
+        ((meta.channels == 1) || (meta.channels == 2))) {
+      _mixStart = meta.audioStart;
+      _mixEnd = meta.audioEnd;
+      _mixRate = meta.sampleRate;
+      _mixChannels = meta.channels;
+    }
+    source->seek(start);
+  } else if (start) {
+    source->seek(start);
+  }
+  _source = source;
+  _sourceStart = start;
+  _vbrChecked = false;
+}
+
+boolean Adafruit_VS1053_FilePlayer::startPlayingSource(
+    Adafruit_VS1053_Source *source, uint32_t start) {
+  if (!source || _recordState != VS1053_REC_IDLE)
+    return false;
+
+  // finish off anything still playing cleanly, so no reset is needed
+  if (_source)
+    stopPlaying();
+
+  uint32_t audioStart;
+  _format = detectFormat(source, &audioStart);
+  if (!start)
+    start = audioStart;
+  return beginPlayback(source, start);
+}
+
+boolean
+Adafruit_VS1053_FilePlayer::beginPlayback(Adafruit_VS1053_Source *source,
+                                          uint32_t start) {
+  prepareSource(source, start);
+
+  // don't let the IRQ get triggered by accident here
+  if (usingInterrupts)
+    noInterrupts();
+
+  // As explained in datasheet, set twice 0 in REG_DECODETIME to set time back
+  // to 0
+  sciWrite(VS1053_REG_DECODETIME, 0x00);
+  sciWrite(VS1053_REG_DECODETIME, 0x00);
+
+  playingMusic = true;
+
+  // wait till its ready for data
+  while (!readyForData()) {
+    delay(1);
+#if defined(ESP8266)
+    ESP.wdtFeed();
+#endif
+  }
+
+  // fill it up! A stream may not have that much yet, so stop when it runs
+  // dry rather than wait with interrupts off, tick() or the IRQ carries on
+  while (playingMusic && readyForData()) {
+    fillFileBuffer();
+    if ((_fileBufferHead == _fileBufferTail) && !_fileEOF)
+      break;
+    feedBuffer();
+  }
+
+  // ok going forward, we can use the IRQ
+  interrupts();
+
+  _playState = VS1053_STATE_PLAYING;
+  if (_trackStarted)
+    _trackStarted(this);
+
+  return true;
+}
+
+boolean
+Adafruit_VS1053_FilePlayer::startPlayingFileAsync(const char *trackname) {
+  if (!trackname)
+    return false;
+  _asyncTrack = trackname;
+  _playState = VS1053_STATE_OPENING;
+  return true;
+}
+
+void Adafruit_VS1053_FilePlayer::tick(void) {
+  if (_recordState != VS1053_REC_IDLE)
+    serviceRecording();
+
+  // while playing the feed does the steps, between bursts of data
+  if (_fading && !playingMusic) {
+    holdBus();
+    fadeStep();
+    interrupts();
+  }
+
+  switch (_playState) {
+  case VS1053_STATE_OPENING: {
+    if (_source) {
+      // the feeder cancels the old track as it goes, DRAINING comes back
+      // here once it's done
+      lockCard();
+      if (_nextOpen)
+        _nextTrack.close();
+      _nextOpen = false;
+      _queuedTrack = NULL;
+      playingMusic = true; // a paused track has to be fed to cancel it
+      startCancel();
+      // DREQ may be high already, so there's no edge to start the feeder
+      feedBuffer_noLock();
+      unlockFeed();
+      closeSeekIndex();
+      _playState = VS1053_STATE_DRAINING;
+      break;
+    }
+    if (_resetPending) {
+      _playState = VS1053_STATE_DRAINING; // which resets, then comes back
+      break;
+    }
+
+    uint32_t start;
+    const char *trackname = _asyncTrack;
+    _asyncTrack = NULL;
+    if (!openTrack(trackname, &start)) {
+      _playState = VS1053_STATE_STOPPED;
+      if (_trackEnded)
+        _trackEnded(this);
+      break;
+    }
+    startPrefill(&_fileSource, start);
+    break;
+  }
+
+  case VS1053_STATE_PREFILLING:
+    // wait for the decoder to come out of reset, but don't block on it
+    if (!readyForData())
+      break;
+    fillFileBuffer();
+    feedBuffer(); // returns once the FIFO is full
+    _playState = VS1053_STATE_PLAYING;
+    if (_trackStarted)
+      _trackStarted(this);
+    break;
+
+  case VS1053_STATE_PLAYING:
+    if (_queuedTrack && !_nextOpen && (_source == &_fileSource) &&
+        lockFeed()) {
+      // get the next track ready while this one plays. The feed lock keeps
+      // the interrupt off the card meanwhile
+      waitForTransport();
+      _nextTrack = SD.open(_queuedTrack);
+      if (_nextTrack) {
+        Adafruit_VS1053_FileSource next(_nextTrack);
+        _nextFormat = detectFormat(&next, &_nextStart);
+        _nextTrack.seek(_nextStart);
+        if (_seekIndex)
+          seekIndexName(_queuedTrack, _nextIndexName);
+        _nextOpen = true;
+      }
+      _queuedTrack = NULL;
+      unlockFeed();
+    }
+    if (_deferReads)
+      fillBuffer();
+    if (!usingInterrupts)
+      feedBuffer();
+    if (_trackSwitched) {
+      _trackSwitched = false;
+      // the old track only has a few ms left in the FIFO, start the clock
+      // for the new one. The feeder's busy with it, keep it off the bus
+      holdBus();
+      sciWrite(VS1053_REG_DECODETIME, 0x00);
+      sciWrite(VS1053_REG_DECODETIME, 0x00);
+      interrupts();
+      if (_seekIndex)
+        openSeekIndex(_nextIndexName);
+      if (_trackStarted)
+        _trackStarted(this);
+    }
+    updateSeekIndex();
+    if (_finishing || (!playingMusic && !_source)) {
+      // all sent, the feeder is flushing the decoder
+      closeSeekIndex();
+      _playState = VS1053_STATE_DRAINING;
+    }
+    break;
+
+  case VS1053_STATE_DRAINING:
+    // the feeder runs the datasheet's end of file or cancel sequence, see
+    // endOfTrack()
+    if (_deferReads)
+      fillBuffer(); // closes the file once it's done
+    if (!usingInterrupts)
+      feedBuffer();
+    if (playingMusic || _source)
+      break;
+    if (_resetPending) {
+      // SM_CANCEL never cleared, so reset. Come back when it's had time
+      if (!_resetting) {
+        startSoftReset();
+        _resetStart = millis();
+        _resetting = true;
+      }
+      if ((millis() - _resetStart) < VS1053_SOFTRESETMS)
+        break;
+      finishSoftReset();
+      _resetting = false;
+      _resetPending = false;
+    }
+
+    if (_asyncTrack) {
+      // a new track was asked for, the old one's out of the way now
+      _playState = VS1053_STATE_OPENING;
+      break;
+    }
+
+    if (_nextOpen) {
+      // not MP3, so it couldn't follow on in the same stream. The decoder's
+      // clean now, start it like any other track
+      currentTrack = _nextTrack;
+      _nextTrack = File();
+      _format = _nextFormat;
+      _nextOpen = false;
+      if (_seekIndex)
+        openSeekIndex(_nextIndexName);
+      startPrefill(&_fileSource, _nextStart);
+      break;
+    }
+    _playState = VS1053_STATE_STOPPED;
+    if (_trackEnded)
+      _trackEnded(this);
+    break;
+
+  default:
+    break;
+  }
+}
+
+void Adafruit_VS1053_FilePlayer::startPrefill(Adafruit_VS1053_Source *source,
+                                              uint32_t start) {
+  prepareSource(source, start);
+
+  holdBus();
+  // As explained in datasheet, set twice 0 in REG_DECODETIME to set time
+  // back to 0
+  sciWrite(VS1053_REG_DECODETIME, 0x00);
+  sciWrite(VS1053_REG_DECODETIME, 0x00);
+  playingMusic = true;
+  interrupts();
+
+  _playState = VS1053_STATE_PREFILLING;
+}
+
+boolean Adafruit_VS1053_FilePlayer::queueFile(const char *trackname) {
+  if (!trackname || _nextOpen || _queuedTrack)
+    return false;
+  _queuedTrack = trackname;
+  return true;
+}
+
+vs1053_playstate_t Adafruit_VS1053_FilePlayer::playState(void) {
+  return _playState;
+}
+
+void Adafruit_VS1053_FilePlayer::onTrackStarted(
+    void (*callback)(Adafruit_VS1053_FilePlayer *player)) {
+  _trackStarted = callback;
+}
+
+void Adafruit_VS1053_FilePlayer::onTrackEnded(
+    void (*callback)(Adafruit_VS1053_FilePlayer *player)) {
+  _trackEnded = callback;
+}
+
+void Adafruit_VS1053_FilePlayer::feedBuffer(void) {
+  if (!lockFeed())
+    return;
+  feedBuffer_noLock();
+  unlockFeed();
+}
+
+// Take the feed lock, so the interrupt can't feed (or touch the bus) until
+// unlockFeed(). If it's already taken the feed is left to whoever has it
+boolean Adafruit_VS1053_FilePlayer::lockFeed(void) {
+  if (usingInterrupts)
+    noInterrupts();
+  // dont run twice in case interrupts collided, but note the request so
+  // the caller holding the lock goes round again instead of dropping it
+  if (_feedBufferLock) {
+    _stats.lockCollisions++;
+    _feedPending = true;
+    interrupts();
+    return false;
+  }
+  _feedBufferLock = true;
+  interrupts();
+  return true;
+}
+
+void Adafruit_VS1053_FilePlayer::unlockFeed(void) {
+  while (true) {
+    // only let go of the lock once nobody asked for another feed
+    if (usingInterrupts)
+      noInterrupts();
+    if (!_feedPending) {
+      _feedBufferLock = false;
+      interrupts();
+      return;
+    }
+    _feedPending = false;
+    interrupts();
+
+    feedBuffer_noLock();
+  }
+}
+
+void Adafruit_VS1053_FilePlayer::feedBuffer_noLock(void) {
+  // the chip's recording, there's nothing to play
+  if (_recordState != VS1053_REC_IDLE) {
+    pollRecording();
+    return;
+  }
+
+  if ((!playingMusic) // paused or stopped
+      || (!_source) || (!readyForData())) {
+    return; // paused or stopped
+  }
+
+  // the FIFO still has nearly all of its data in it when DREQ goes high, so
+  // a volume step now can't starve it. The bus is ours unless a transfer's
+  // in flight
+  if (_fading && !(sdiTransport && sdiTransport->busy()))
+    fadeStep();
+
+  uint32_t now = micros();
+  if (_lastFeed && ((now - _lastFeed) > _stats.maxFeedInterval))
+    _stats.maxFeedInterval = now - _lastFeed;
+  _lastFeed = now;
+  _stats.feeds++;
+
+  // a stop is under way, see startCancel(). It sends without the transport
+  if (_cancelling) {
+    endOfTrack();
+    return;
+  }
+
+  if (sdiTransport) {
+    feedTransport();
+    return;
+  }
+
+  // Feed the hungry buffer! :)
+  while (feedReady()) {
+    // Top up from the SD card, this only reads when a whole block is free
+    if (!_deferReads)
+      fillFileBuffer();
+
+    uint16_t buffered = _fileBufferHead - _fileBufferTail;
+    if (buffered == 0) {
+      if (_fileEOF)
+        endOfTrack();
+      else
+        _stats.underruns++; // fillBuffer() hasn't caught up yet
+      break;
+    }
+
+    // Don't wrap around the end of the buffer in one go
+    uint16_t tail = _fileBufferTail & (VS1053_FILEBUFFERLEN - 1);
+    uint16_t len = VS1053_FILEBUFFERLEN - tail;
+    if (len > buffered)
+      len = buffered;
+    if (!_burstFeed && (len > VS1053_DATABUFFERLEN))
+      len = VS1053_DATABUFFERLEN;
+    mixFeed(len);
+
+    uint32_t start = micros();
+    uint16_t sent = len;
+    if (_burstFeed) {
+      // as many DREQ's worth as the decoder will take under one CS
+      sent = playDataBurst(_fileBuffer + tail, len);
+    } else {
+      // one DREQ's worth
+      playData(_fileBuffer + tail, len);
+    }
+    _stats.sdiTime += micros() - start;
+    if (sent)
+      _stats.sdiTransfers++;
+    _fileBufferTail += sent;
+    _stats.bytesFed += sent;
+    if (sent < len)
+      break; // FIFO is full
+  }
+}
+
+// readyForData() for the feed loop, timed for the stats
+boolean Adafruit_VS1053_FilePlayer::feedReady(void) {
+  uint32_t start = micros();
+  boolean ready = readyForData();
+  _stats.pollTime += micros() - start;
+  return ready;
+}
+
+void Adafruit_VS1053_FilePlayer::feedTransport(void) {
+  // the completion callback brings us back here, nothing to do till then
+  if (sdiTransport->busy())
+    return;
+
+  // the last block is out, it's safe to reuse its space
+  _fileBufferTail += _transferLen;
+  _transferLen = 0;
+
+  if (!_deferReads)
+    fillFileBuffer();
+
+  uint16_t buffered = _fileBufferHead - _fileBufferTail;
+  if (buffered == 0) {
+    if (_fileEOF)
+      endOfTrack();
+    else
+      _stats.underruns++;
+    return;
+  }
+
+  uint16_t tail = _fileBufferTail & (VS1053_FILEBUFFERLEN - 1);
+  uint16_t len = VS1053_FILEBUFFERLEN - tail;
+  if (len > buffered)
+    len = buffered;
+  if (len > VS1053_DATABUFFERLEN)
+    len = VS1053_DATABUFFERLEN;
+  mixFeed(len);
+
+  // only the time to start it, the transfer itself runs in the background
+  uint32_t start = micros();
+  if (sdiTransport->startWrite(_fileBuffer + tail, len)) {
+    _transferLen = len;
+    _stats.bytesFed += len;
+    _stats.sdiTransfers++;
+  }
+  _stats.sdiTime += micros() - start;
+}
+
+// Mix the prompt into the next len bytes the feeder is about to send
+void Adafruit_VS1053_FilePlayer::mixFeed(uint16_t len) {
+  if (!_mixStart)
+    return;
+
+  // catch up if the feeder went past half a sample last time
+  uint16_t behind = _fileBufferTail - _mixHead;
+  if (behind <= VS1053_FILEBUFFERLEN)
+    mixSkip(behind);
+  uint16_t end = _fileBufferTail + len;
+  uint16_t todo = end - _mixHead;
+  if (!todo || (todo > VS1053_FILEBUFFERLEN))
+    return; // mixed already, a burst didn't send it all
+
+  if (!_promptLeft && (_duckGain == 0x10000)) {
+    // nothing to mix in, just keep count
+    mixSkip(todo);
+    return;
+  }
+
+  uint32_t start = micros();
+  while (_mixHead != end) {
+    mixSkip(0);
+    uint32_t offset = _mixPos - _mixStart;
+    if ((_mixPos < _mixStart) || (_mixPos >= _mixEnd) || (offset & 1)) {
+      // not sample data, or out of step after a seek. A looped track
+      // carries the prompt on into the next pass
+      if ((_mixPos >= _mixEnd) && !_loopPlayback) {
+        _promptLeft = 0;
+        _duckGain = 0x10000;
+      }
+      mixSkip(1);
+      continue;
+    }
+    if ((uint16_t)(end - _mixHead) < 2)
+      break; // the other half goes next time
+
+    // a new frame starts with its first channel
+    if ((_mixChannels == 1) || !(offset & 2))
+      nextMixFrame();
+
+    uint16_t lo = _mixHead & (VS1053_FILEBUFFERLEN - 1);
+    uint16_t hi = (_mixHead + 1) & (VS1053_FILEBUFFERLEN - 1);
+    int32_t sample = (int16_t)(_fileBuffer[lo] | (_fileBuffer[hi] << 8));
+    sample = ((sample * (int32_t)_duckGain) >> 16) + _promptSample;
+    if (sample > 32767)
+      sample = 32767;
+    if (sample < -32768)
+      sample = -32768;
+    _fileBuffer[lo] = sample;
+    _fileBuffer[hi] = (uint16_t)sample >> 8;
+
+    mixSkip(2);
+  }
+  _stats.mixTime += micros() - start;
+}
+
+// Move the mixer on len bytes, following the reader back to the start of
+// the source if it looped or switched tracks in between
+void Adafruit_VS1053_FilePlayer::mixSkip(uint16_t len) {
+  uint16_t toRestart = _mixRestartHead - _mixHead;
+  if (_mixRestart && (toRestart <= len)) {
+    _mixPos = _mixRestartPos + (uint16_t)(len - toRestart);
+    _mixRestart = false;
+  } else {
+    _mixPos += len;
+  }
+  _mixHead += len;
+}
+
+void Adafruit_VS1053_FilePlayer::nextMixFrame(void) {
+  uint32_t target = 0x10000;
+  _promptSample = 0;
+  if (_promptLeft) {
+    _promptSample = _promptProgmem ? (int16_t)pgm_read_word(_prompt) : *_prompt;
+    _prompt++;
+    _promptLeft = _promptLeft - 1;
+    target = _duckLevel;
+  }
+
+  if (_duckGain > target)
+    _duckGain = ((_duckGain - target) > _duckStep) ? (_duckGain - _duckStep)
+                                                   : target;
+  else if (_duckGain < target)
+    _duckGain = ((target - _duckGain) > _duckStep) ? (_duckGain + _duckStep)
+                                                   : target;
+}
+
+boolean Adafruit_VS1053_FilePlayer::playPrompt(const int16_t *clip,
+                                               uint32_t samples,
+                                               boolean progmem) {
+  if (!_source || !_mixStart || !clip)
+    return false;
+
+  uint32_t frames = (uint32_t)_duckRampMs * _mixRate / 1000;
+  uint32_t step = (0x10000 - _duckLevel) / (frames ? frames : 1);
+
+  // the feeder may be mixing from the interrupt
+  if (usingInterrupts)
+    noInterrupts();
+  _duckStep = step ? step : 1;
+  _prompt = clip;
+  _promptProgmem = progmem;
+  _promptLeft = samples;
+  interrupts();
+  return true;
+}
+
+boolean Adafruit_VS1053_FilePlayer::prompting(void) {
+  return _promptLeft != 0;
+}
+
+void Adafruit_VS1053_FilePlayer::setDucking(uint16_t level, uint16_t rampMs) {
+  if (level > 256)
+    level = 256;
+  _duckLevel = (uint32_t)level << 8;
+  _duckRampMs = rampMs;
+}
+
+void Adafruit_VS1053_FilePlayer::fadeTo(uint8_t left, uint8_t right,
+                                         uint16_t durationMs,
+                                         vs1053_fadecurve_t curve) {
+  uint16_t target = ((uint16_t)left << 8) | right;
+
+  if (usingInterrupts)
+    noInterrupts();
+  _fading = false;
+  if (!durationMs) {
+    interrupts();
+    setVolume(left, right);
+    return;
+  }
+  _fadeFrom = sciReadCached(VS1053_REG_VOLUME);
+  _fadeVolume = _fadeFrom;
+  _fadeTarget = target;
+  _fadeDuration = durationMs;
+  _fadeCurve = curve;
+  _fadeStart = millis();
+  _fadeLast = _fadeStart;
+  _fading = true;
+  interrupts();
+}
+
+boolean Adafruit_VS1053_FilePlayer::fading(void) { return _fading; }
+
+void Adafruit_VS1053_FilePlayer::fadeStep(void) {
+  uint32_t now = millis();
+  uint32_t elapsed = now - _fadeStart;
+  uint16_t volume = _fadeTarget;
+
+  if (elapsed < _fadeDuration) {
+    if ((now - _fadeLast) < VS1053_FADEINTERVAL)
+      return;
+
+    // how far through the fade we are, out of 256
+    uint32_t t = (elapsed << 8) / _fadeDuration;
+    switch (_fadeCurve) {
+    case VS1053_FADE_EASEIN:
+      t = (t * t) >> 8;
+      break;
+    case VS1053_FADE_EASEOUT:
+      t = 256 - (((256 - t) * (256 - t)) >> 8);
+      break;
+    case VS1053_FADE_SMOOTH:
+      t = (t * t * (3 * 256 - 2 * t)) >> 16; // 3t^2 - 2t^3
+      break;
+    default:
+      break;
+    }
+
+    // each channel on its own
+    volume = 0;
+    for (uint8_t shift = 0; shift <= 8; shift += 8) {
+      int16_t from = (_fadeFrom >> shift) & 0xFF;
+      int16_t to = (_fadeTarget >> shift) & 0xFF;
+      volume |= (uint16_t)(from + (((to - from) * (int32_t)t) >> 8)) << shift;
+    }
+  } else {
+    _fading = false;
+  }
+  _fadeLast = now;
+
+  if (volume != _fadeVolume) {
+    sciWrite(VS1053_REG_VOLUME, volume);
+    _fadeVolume = volume;
+  }
+}
+
+void Adafruit_VS1053_FilePlayer::fillFileBuffer(void) {
+  boolean rewound = false;
+
+  while ((uint16_t)(VS1053_FILEBUFFERLEN -
+                    (uint16_t)(_fileBufferHead - _fileBufferTail)) >=
+         VS1053_FILEREADLEN) {
+    // read up to the next block boundary so reads stay sector aligned
+    uint16_t head = _fileBufferHead & (VS1053_FILEBUFFERLEN - 1);
+    uint16_t len = VS1053_FILEREADLEN - (head % VS1053_FILEREADLEN);
+
+    uint32_t start = micros();
+    int bytesread = _source->read(_fileBuffer + head, len);
+    uint32_t elapsed = micros() - start;
+    _stats.readTime += elapsed;
+    if (elapsed > _stats.maxReadTime)
+      _stats.maxReadTime = elapsed;
+
+    if (bytesread > 0) {
+      _fileBufferHead += bytesread;
+      continue;
+    }
+    if (bytesread == 0)
+      return; // nothing more right now
+
+    // end of the stream, carry straight on with the queued track if
+    // tick() has it open
+    if (_nextOpen && (_source == &_fileSource)) {
+      // MP3 frames can simply follow each other. Anything else needs the
+      // decoder finished and cancelled in between, tick() starts it then
+      if ((_nextFormat != VS1053_FORMAT_MP3) ||
+          (_format != VS1053_FORMAT_MP3)) {
+        _fileEOF = true;
+        return;
+      }
+      currentTrack.close();
+      currentTrack = _nextTrack;
+      _nextTrack = File();
+      _sourceStart = _nextStart;
+      _format = _nextFormat;
+      _vbrChecked = false;
+      _nextOpen = false;
+      _trackSwitched = true;
+      _mixRestart = true;
+      _mixRestartHead = _fileBufferHead;
+      _mixRestartPos = _nextStart;
+      continue;
+    }
+
+    // start over if we're looping (but only once, in case it's empty)
+    if (!_loopPlayback || rewound || !_source->seek(_sourceStart)) {
+      _fileEOF = true;
+      return;
+    }
+    rewound = true;
+    _mixRestart = true;
+    _mixRestartHead = _fileBufferHead;
+    _mixRestartPos = _sourceStart;
+  }
+}
+
+void Adafruit_VS1053_FilePlayer::resetFileBuffer(void) {
+  _fileBufferHead = 0;
+  _fileBufferTail = 0;
+  _mixHead = 0;
+  _mixRestart = false;
+  _transferLen = 0;
+  _fileEOF = false;
+  _finishing = false;
+  _cancelling = false;
+  _drainLeft = 0;
+  _cancelLeft = 0;
+  _lastFeed = 0; // don't count the gap between tracks
+}
+
+void Adafruit_VS1053_FilePlayer::endOfTrack(void) {
+  // Datasheet 'Playing a whole file': push the end of the track through
+  // with endFillByte, then cancel, checking SM_CANCEL every 32 bytes. After
+  // startCancel() it's 'Cancelling playback' instead, where the track goes
+  // on until SM_CANCEL clears and the endFillByte flush comes last. This
+  // runs from the feeder, so it's done as DREQ allows
+  if (!_finishing) {
+    _endFillByte = endFillByte();
+    _drainLeft = VS1053_ENDFILLLEN;
+    _cancelLeft = VS1053_CANCELLEN;
+    _finishing = true;
+  }
+
+  uint8_t fill[VS1053_DATABUFFERLEN];
+  memset(fill, _endFillByte, sizeof(fill));
+  while (true) {
+    if (!readyForData())
+      return; // more next time
+    if (_drainLeft) {
+      uint8_t len = (_drainLeft > VS1053_DATABUFFERLEN) ? VS1053_DATABUFFERLEN
+                                                        : _drainLeft;
+      playData(fill, len);
+      _drainLeft -= len;
+      if (_drainLeft)
+        continue;
+      if (_cancelling)
+        break; // flushed after the cancel, all done
+      sciWrite(VS1053_REG_MODE,
+               sciReadCached(VS1053_REG_MODE) | VS1053_MODE_SM_CANCEL);
+      continue;
+    }
+    if (!(sciRead(VS1053_REG_MODE) & VS1053_MODE_SM_CANCEL)) {
+      if (!_cancelling)
+        break;
+      // it's let go, only now is endFillByte right for the flush
+      _endFillByte = endFillByte();
+      memset(fill, _endFillByte, sizeof(fill));
+      _drainLeft = VS1053_ENDFILLLEN;
+      continue;
+    }
+    if (_cancelLeft == 0) {
+      // it never let go, the datasheet says reset. That can't be done from
+      // the interrupt, so it's left for tick() or the next track
+      _resetPending = true;
+      break;
+    }
+    uint8_t sent = VS1053_DATABUFFERLEN;
+    if (_cancelling)
+      sent = sendCancelData();
+    else
+      playData(fill, sent);
+    _cancelLeft -= (sent < _cancelLeft) ? sent : _cancelLeft;
+  }
+  if (_cancelling) {
+    // nothing more of it gets played, fillBuffer() can close it
+    _fileBufferTail = _fileBufferHead;
+    _fileEOF = true;
+  }
+  _finishing = false;
+  _cancelling = false;
+
+  // wrap it up! With deferred reads the file belongs to fillBuffer(), which
+  // closes it the next time round
+  playingMusic = false;
+  if (_source && !_deferReads)
+    closeSource();
+}
+
+void Adafruit_VS1053_FilePlayer::closeSource(void) {
+  _source->close();
+  _source = NULL;
+}
+
+/***************************************************************/
+
+/* Recording */
+
+boolean Adafruit_VS1053_FilePlayer::openRecording(const char *filename) {
+  if (_recordState != VS1053_REC_IDLE)
+    return false;
+  // the file buffer is needed for the recording
+  if (_source)
+    stopPlaying();
+
+  if (SD.exists(filename))
+    SD.remove(filename);
+  _recordFile = SD.open(filename, VS1053_FILE_UPDATE);
+  if (!_recordFile)
+    return false;
+
+  resetFileBuffer();
+  memset(&_recordStats, 0, sizeof(_recordStats));
+  _recordPad = 0;
+  return true;
+}
+
+boolean Adafruit_VS1053_FilePlayer::startRecordingOgg(const char *filename,
+                                                      boolean mic) {
+  if (!openRecording(filename))
+    return false;
+
+  _recordFormat = VS1053_FORMAT_OGG;
+  startRecordOgg(mic);
+  _recordLastPoll = micros();
+  _recordInterval = VS1053_RECPOLLMIN;
+  // the poller leaves us alone until now
+  _recordState = VS1053_REC_RUNNING;
+  return true;
+}
+
+boolean Adafruit_VS1053_FilePlayer::startRecordingWAV(const char *filename,
+                                                      uint16_t rate,
+                                                      uint8_t channels,
+                                                      boolean adpcm,
+                                                      boolean mic) {
+  if (!openRecording(filename))
+    return false;
+
+  _recordFormat = VS1053_FORMAT_WAV;
+  _recordADPCM = adpcm;
+  _recordChannels = (channels == 2) ? 2 : 1;
+  _recordRate = rate;
+  // sizes are left at 0 until the end
+  if (!writeWAVHeader()) {
+    _recordFile.close();
+    return false;
+  }
+
+  if (adpcm)
+    startRecordADPCM(rate, _recordChannels, mic);
+  else
+    startRecordPCM(rate, _recordChannels, mic);
+  _recordLastPoll = micros();
+  _recordInterval = VS1053_RECPOLLMIN;
+  _recordState = VS1053_REC_RUNNING;
+  return true;
+}
+
+void Adafruit_VS1053_FilePlayer::stopRecording(void) {
+  if (_recordState != VS1053_REC_RUNNING)
+    return;
+  if (usingInterrupts)
+    noInterrupts();
+  // PCM just stops once what's waiting now is in, see pollRecording()
+  if (_recordFormat == VS1053_FORMAT_OGG)
+    stopRecordOgg();
+  _recordState = VS1053_REC_STOPPING;
+  interrupts();
+}
+
+boolean Adafruit_VS1053_FilePlayer::recording(void) {
+  return _recordState != VS1053_REC_IDLE;
+}
+
+void Adafruit_VS1053_FilePlayer::getRecordStats(vs1053_recordstats_t *stats) {
+  noInterrupts();
+  *stats = _recordStats;
+  interrupts();
+}
+
+void Adafruit_VS1053_FilePlayer::serviceRecording(void) {
+  // only the poller sets this, and it's done with the ring once it has
+  boolean drained = (_recordState == VS1053_REC_DRAINED);
+
+  // polls through the feed lock, so it can't collide with the interrupt
+  feedBuffer();
+  if (!writeRecordedBlocks() || !drained)
+    return;
+  finishRecording();
+}
+
+void Adafruit_VS1053_FilePlayer::pollRecording(void) {
+  if ((_recordState != VS1053_REC_RUNNING) &&
+      (_recordState != VS1053_REC_STOPPING))
+    return;
+
+  uint32_t now = micros();
+  uint32_t elapsed = now - _recordLastPoll;
+  boolean stopping = (_recordState == VS1053_REC_STOPPING);
+  if (!stopping && (elapsed < _recordInterval))
+    return;
+
+  // the Ogg encoder sets AICTRL3 bit 1 once all its data is in the buffer
+  boolean finished =
+      stopping && ((_recordFormat != VS1053_FORMAT_OGG) ||
+                   (sciRead(VS1053_SCI_AICTRL3) & _BV(1)));
+  uint16_t waiting = recordedWordsWaiting();
+  if (waiting > _recordStats.maxWaiting)
+    _recordStats.maxWaiting = waiting;
+  if (waiting > VS1053_RECOVERFLOW)
+    _recordStats.overruns++;
+  _recordStats.polls++;
+  uint16_t left = readRecording(waiting);
+
+  // come back when about a quarter of the chip's buffer should be waiting
+  _recordLastPoll = now;
+  _recordInterval = waiting ? (elapsed / waiting) * (VS1053_RECBUFLEN / 4)
+                            : VS1053_RECPOLLMAX;
+  if (_recordInterval < VS1053_RECPOLLMIN)
+    _recordInterval = VS1053_RECPOLLMIN;
+  if (_recordInterval > VS1053_RECPOLLMAX)
+    _recordInterval = VS1053_RECPOLLMAX;
+
+  if (finished && !left) {
+    // AICTRL3 bit 2 means the Ogg stream had an odd length, so the low
+    // byte of the last word is padding
+    if (_recordFormat == VS1053_FORMAT_OGG)
+      _recordPad = (sciRead(VS1053_SCI_AICTRL3) & _BV(2)) ? 1 : 0;
+    _recordState = VS1053_REC_DRAINED;
+  }
+}
+
+uint16_t Adafruit_VS1053_FilePlayer::readRecording(uint16_t waiting) {
+  while (waiting) {
+    uint16_t room = VS1053_FILEBUFFERLEN -
+                    (uint16_t)(_fileBufferHead - _fileBufferTail);
+    if (room < 2) {
+      _recordStats.ringFull++;
+      break;
+    }
+
+    // don't wrap around the end of the buffer in one go
+    uint16_t head = _fileBufferHead & (VS1053_FILEBUFFERLEN - 1);
+    uint16_t words = (VS1053_FILEBUFFERLEN - head) / 2;
+    if (words > room / 2)
+      words = room / 2;
+    if (words > waiting)
+      words = waiting;
+    recordedRead(_fileBuffer + head, words);
+    _fileBufferHead += words * 2;
+    waiting -= words;
+  }
+
+  uint16_t buffered = _fileBufferHead - _fileBufferTail;
+  if (buffered > _recordStats.maxBuffered)
+    _recordStats.maxBuffered = buffered;
+  return waiting;
+}
+
+boolean Adafruit_VS1053_FilePlayer::writeRecording(uint16_t offset,
+                                                   uint16_t len) {
+  if ((_recordFormat == VS1053_FORMAT_WAV) && !_recordADPCM) {
+    // PCM words come big endian, WAV wants them little endian
+    for (uint16_t i = 0; i + 1 < len; i += 2) {
+      uint8_t b = _fileBuffer[offset + i];
+      _fileBuffer[offset + i] = _fileBuffer[offset + i + 1];
+      _fileBuffer[offset + i + 1] = b;
+    }
+  }
+  // the chip shares the bus with the card, so a poll the interrupt asks for
+  // meanwhile is held off and done by unlockFeed() as soon as the write is
+  // out. It only fills the ring past the head, this block is left alone
+  lockCard();
+  uint32_t start = micros();
+  size_t written = _recordFile.write(_fileBuffer + offset, len);
+  uint32_t elapsed = micros() - start;
+  if (elapsed > _recordStats.maxWriteTime)
+    _recordStats.maxWriteTime = elapsed;
+
+  if (written != len) {
+    // card full or gone, keep what we have
+    if (_recordFormat == VS1053_FORMAT_WAV)
+      stopRecordPCM();
+    else if (_recordState == VS1053_REC_RUNNING)
+      stopRecordOgg();
+    _recordFile.close();
+    _recordState = VS1053_REC_IDLE;
+    unlockFeed();
+    return false;
+  }
+  unlockFeed();
+  _recordStats.bytesWritten += len;
+  return true;
+}
+
+boolean Adafruit_VS1053_FilePlayer::writeRecordedBlocks(void) {
+  while (true) {
+    if (usingInterrupts)
+      noInterrupts();
+    uint16_t buffered = _fileBufferHead - _fileBufferTail;
+    interrupts();
+
+    // hold the last word back until the encoder says if it's padded
+    if (buffered <= VS1053_FILEREADLEN)
+      return true;
+    if (!writeRecording(_fileBufferTail & (VS1053_FILEBUFFERLEN - 1),
+                        VS1053_FILEREADLEN))
+      return false;
+
+    if (usingInterrupts)
+      noInterrupts();
+    _fileBufferTail += VS1053_FILEREADLEN;
+    interrupts();
+  }
+}
+
+void Adafruit_VS1053_FilePlayer::finishRecording(void) {
+  // the tail only moves a block at a time, so what's left is in one piece
+  uint16_t buffered = _fileBufferHead - _fileBufferTail;
+  if (buffered &&
+      !writeRecording(_fileBufferTail & (VS1053_FILEBUFFERLEN - 1),
+                      buffered - _recordPad))
+    return;
+  resetFileBuffer();
+
+  if (_recordFormat == VS1053_FORMAT_WAV) {
+    stopRecordPCM();
+
+    // fill out the last block with silence (zeros decode to it in ADPCM
+    // too), players drop a partial one
+    uint16_t align =
+        _recordChannels * (_recordADPCM ? VS1053_ADPCMBLOCKLEN : 2);
+    uint16_t pad = (align - _recordStats.bytesWritten % align) % align;
+    memset(_fileBuffer, 0, VS1053_FILEBUFFERLEN);
+    while (pad) {
+      uint16_t len = (pad > VS1053_FILEBUFFERLEN) ? VS1053_FILEBUFFERLEN : pad;
+      if (!writeRecording(0, len))
+        return;
+      pad -= len;
+    }
+    writeWAVHeader();
+  }
+  _recordFile.close();
+  _recordState = VS1053_REC_IDLE;
+}
+
+boolean Adafruit_VS1053_FilePlayer::writeWAVHeader(void) {
+  uint8_t header[VS1053_WAVHEADERMAX];
+  uint8_t len = wavHeader(header, _recordADPCM, _recordChannels, _recordRate,
+                          _recordStats.bytesWritten);
+
+  if (!_recordFile.seek(0))
+    return false;
+  return _recordFile.write(header, len) == len;
+}
+
+/***************************************************************/
+
+/* Audio sources */
+
+int Adafruit_VS1053_FileSource::read(uint8_t *buffer, size_t len) {
+  // a file has all its data available, so 0 means the end
+  int bytesread = _file.read(buffer, len);
+  return (bytesread > 0) ? bytesread : -1;
+}
+
+uint32_t Adafruit_VS1053_FileSource::available(void) {
+  return _file.available();
+}
+
+boolean Adafruit_VS1053_FileSource::seek(uint32_t pos) {
+  return _file.seek(pos);
+}
+
+uint32_t Adafruit_VS1053_FileSource::position(void) { return _file.position(); }
+
+uint32_t Adafruit_VS1053_FileSource::size(void) { return _file.size(); }
+
+void Adafruit_VS1053_FileSource::close(void) { _file.close(); }
+
+int Adafruit_VS1053_MemorySource::read(uint8_t *buffer, size_t len) {
+  if (_pos >= _len)
+    return -1;
+  if (len > _len - _pos)
+    len = _len - _pos;
+
+  if (_progmem) {
+#if defined(__AVR__) || defined(ESP8266)
+    memcpy_P(buffer, _data + _pos, len);
+#else
+    memcpy(buffer, _data + _pos, len);
+#endif
+  } else {
+    memcpy(buffer, _data + _pos, len);
+  }
+  _pos += len;
+  return len;
+}
+
+uint32_t Adafruit_VS1053_MemorySource::available(void) { return _len - _pos; }
+
+boolean Adafruit_VS1053_MemorySource::seek(uint32_t pos) {
+  if (pos > _len)
+    return false;
+  _pos = pos;
+  return true;
+}
+
+uint32_t Adafruit_VS1053_MemorySource::position(void) { return _pos; }
+
+uint32_t Adafruit_VS1053_MemorySource::size(void) { return _len; }
+
+int Adafruit_VS1053_StreamSource::read(uint8_t *buffer, size_t len) {
+  // only take what's already arrived, never wait for more
+  size_t n = _stream.available();
+  if (n == 0)
+    return 0;
+  if (len > n)
+    len = n;
+  return _stream.readBytes(buffer, len);
+}
+
+uint32_t Adafruit_VS1053_StreamSource::available(void) {
+  return _stream.available();
+}
+
+// One byte is always left empty so a full buffer can be told from an empty
+// one without a shared count
+size_t Adafruit_VS1053_PushSource::write(const uint8_t *data, size_t len) {
+  uint32_t space = availableForWrite();
+  if (len > space)
+    len = space;
+
+  uint32_t head = _head;
+  for (size_t i = 0; i < len; i++) {
+    _buffer[head++] = data[i];
+    if (head == _len)
+      head = 0;
+  }
+  _head = head; // publish once the data is in
+  return len;
+}
+
+uint32_t Adafruit_VS1053_PushSource::availableForWrite(void) {
+  return _len - 1 - available();
+}
+
+void Adafruit_VS1053_PushSource::clear(void) {
+  _head = 0;
+  _tail = 0;
+  _ended = false;
+}
+
+int Adafruit_VS1053_PushSource::read(uint8_t *buffer, size_t len) {
+  uint32_t avail = available();
+  if (avail == 0)
+    return _ended ? -1 : 0;
+  if (len > avail)
+    len = avail;
+
+  uint32_t tail = _tail;
+  for (size_t i = 0; i < len; i++) {
+    buffer[i] = _buffer[tail++];
+    if (tail == _len)
+      tail = 0;
+  }
+  _tail = tail;
+  return len;
+}
 
-  char tag[4];
-  uint32_t start;
-  unsigned long current;
+uint32_t Adafruit_VS1053_PushSource::available(void) {
+  uint32_t head = _head, tail = _tail;
+  return (head >= tail) ? (head - tail) : (_len - tail + head);
+}
 
-  start = 0;
-  if (mp3) {
-    current = mp3.position();
-    if (mp3.seek(0)) {
-      if (mp3.read((uint8_t *)tag, 3)) {
-        tag[3] = '\0';
-        if (!strcmp(tag, "ID3")) {
-          if (mp3.seek(6)) {
-            start = 0ul;
-            for (byte i = 0; i < 4; i++) {
-              start <<= 7;
-              start |= (0x7F & mp3.read());
-            }
-          } else {
-            // Serial.println("Second seek failed?");
-          }
-        } else {
-          // Serial.println("It wasn't the damn TAG.");
-        }
-      } else {
-        // Serial.println("Read for the tag failed");
-      }
-    } else {
-      // Serial.println("Seek failed? How can seek fail?");
+/***************************************************************/
+
+/* Track metadata */
+
+// Copy tag text into one of the metadata strings. Latin-1 and UTF-8 are
+// copied as they are, UTF-16 is cut down to Latin-1 with '?' for anything
+// that doesn't fit
+static void copyTag(char *dst, const uint8_t *src, size_t len,
+                    uint8_t encoding) {
+  size_t n = 0;
+  if ((encoding == 1) || (encoding == 2)) {
+    boolean bigEndian = (encoding == 2);
+    if ((len >= 2) && (src[0] == 0xFF) && (src[1] == 0xFE)) {
+      bigEndian = false;
+      src += 2;
+      len -= 2;
+    } else if ((len >= 2) && (src[0] == 0xFE) && (src[1] == 0xFF)) {
+      bigEndian = true;
+      src += 2;
+      len -= 2;
+    }
+    for (size_t i = 0; (i + 1 < len) && (n < VS1053_TAGLEN - 1); i += 2) {
+      uint16_t c = bigEndian ? ((src[i] << 8) | src[i + 1])
+                             : ((src[i + 1] << 8) | src[i]);
+      if (!c)
+        break;
+      dst[n++] = (c < 0x100) ? c : '?';
     }
-    mp3.seek(current); // Put you things away like you found 'em.
   } else {
-    // Serial.println("They handed us a NULL file!");
+    for (size_t i = 0; (i < len) && (n < VS1053_TAGLEN - 1) && src[i]; i++)
+      dst[n++] = src[i];
   }
-  // Serial.print("Jumper returning: "); Serial.println(start);
-  return start;
+  // ID3v1 pads with spaces
+  while ((n > 0) && (dst[n - 1] == ' '))
+    n--;
+  dst[n] = 0;
 }
 
-boolean Adafruit_VS1053_FilePlayer::startPlayingFile(const char *trackname) {
-  // reset playback
-  sciWrite(VS1053_REG_MODE, VS1053_MODE_SM_LINE1 | VS1053_MODE_SM_SDINEW |
-                                VS1053_MODE_SM_LAYER12);
-  // resync
-  sciWrite(VS1053_REG_WRAMADDR, 0x1e29);
-  sciWrite(VS1053_REG_WRAM, 0);
+// 0 = title, 1 = artist, 2 = album
+static char *metaField(vs1053_metadata_t *meta, uint8_t field) {
+  switch (field) {
+  case 0:
+    return meta->title;
+  case 1:
+    return meta->artist;
+  case 2:
+    return meta->album;
+  }
+  return NULL;
+}
 
-  currentTrack = SD.open(trackname);
-  if (!currentTrack) {
-    return false;
+// String for an APE item or Vorbis comment key, or NULL if it's not one
+// we keep. Both use the same key names, in any case
+static char *commentField(vs1053_metadata_t *meta, const uint8_t *key,
+                          size_t len) {
+  static const char *const keys[] = {"TITLE", "ARTIST", "ALBUM"};
+  for (uint8_t f = 0; f < 3; f++) {
+    if ((strlen(keys[f]) == len) &&
+        !strncasecmp((const char *)key, keys[f], len))
+      return metaField(meta, f);
   }
+  return NULL;
+}
 
-  // We know we have a valid file. Check if .mp3
-  // If so, check for ID3 tag and jump it if present.
-  if (isMP3File(trackname)) {
-    currentTrack.seek(mp3_ID3Jumper(currentTrack));
+// Walk the ID3v2 frames, reading only the text frames we want and seeking
+// past everything else (cover art can be hundreds of KB)
+static void readID3v2(Adafruit_VS1053_Source *source, const uint8_t *header,
+                      vs1053_metadata_t *meta) {
+  static const char v22Frames[][4] = {"TT2", "TP1", "TAL", "TLE"};
+  static const char v23Frames[][5] = {"TIT2", "TPE1", "TALB", "TLEN"};
+  uint8_t version = header[3];
+  uint8_t flags = header[5];
+  uint32_t end = 10 + syncsafe(header + 6);
+  uint32_t pos = 10;
+  // encoding byte, BOM and a full string of UTF-16
+  uint8_t buf[2 * VS1053_TAGLEN + 3];
+
+  // tag wide unsynchronisation (v2.2/2.3) or compression (v2.2) would have
+  // to be undone before the frames can be read
+  if ((version < 2) || (version > 4) || ((flags & 0x80) && (version < 4)) ||
+      ((flags & 0x40) && (version == 2)))
+    return;
+  if (flags & 0x40) {
+    // extended header, v2.3 doesn't count its own size
+    if (!readAt(source, pos, buf, 4))
+      return;
+    pos += (version == 3) ? be32(buf) + 4 : syncsafe(buf);
   }
 
-  // don't let the IRQ get triggered by accident here
-  if (usingInterrupts)
-    noInterrupts();
+  uint8_t headerLen = (version == 2) ? 6 : 10;
+  uint8_t idLen = (version == 2) ? 3 : 4;
+  while (pos + headerLen <= end) {
+    if (!readAt(source, pos, buf, headerLen) || !buf[0])
+      break; // padding
+    uint32_t len;
+    boolean skip = false;
+    if (version == 2) {
+      len = ((uint32_t)buf[3] << 16) | ((uint32_t)buf[4] << 8) | buf[5];
+    } else {
+      len = (version == 4) ? syncsafe(buf + 4) : be32(buf + 4);
+      // compressed, encrypted, grouped or unsynchronised frames
+      skip = buf[9] & ((version == 4) ? 0x4E : 0xE0);
+    }
 
-  // As explained in datasheet, set twice 0 in REG_DECODETIME to set time back
-  // to 0
-  sciWrite(VS1053_REG_DECODETIME, 0x00);
-  sciWrite(VS1053_REG_DECODETIME, 0x00);
+    int8_t field = -1;
+    for (uint8_t f = 0; f < 4; f++) {
+      if (!memcmp(buf, (version == 2) ? v22Frames[f] : v23Frames[f], idLen))
+        field = f;
+    }
+    pos += headerLen;
+
+    if ((field >= 0) && !skip && (len > 1)) {
+      size_t n = (len < sizeof(buf)) ? len : sizeof(buf);
+      char *dst = metaField(meta, field);
+      if (dst && !dst[0] && readAt(source, pos, buf, n)) {
+        copyTag(dst, buf + 1, n - 1, buf[0]);
+      } else if (!dst && readAt(source, pos, buf, n)) {
+        char ms[VS1053_TAGLEN]; // TLEN is the length in ms, as text
+        copyTag(ms, buf + 1, n - 1, buf[0]);
+        meta->durationMs = strtoul(ms, NULL, 10);
+      }
+    }
+    pos += len;
+  }
+}
 
-  playingMusic = true;
+// APEv2 and ID3v1 tags both sit at the end of an MP3, APE first. Fields
+// already set from ID3v2 are kept, then APE, then ID3v1 fills any gaps
+static void readTrailingTags(Adafruit_VS1053_Source *source,
+                             vs1053_metadata_t *meta) {
+  uint8_t buf[VS1053_TAGLEN + 8];
+  uint32_t end = meta->audioEnd;
+  uint32_t id3v1 = 0;
+
+  if ((end >= meta->audioStart + 128) && readAt(source, end - 128, buf, 3) &&
+      !memcmp(buf, "TAG", 3)) {
+    end -= 128;
+    id3v1 = end;
+  }
 
-  // wait till its ready for data
-  while (!readyForData()) {
-    delay(1);
-#if defined(ESP8266)
-    ESP.wdtFeed();
-#endif
+  if ((end >= meta->audioStart + 32) && readAt(source, end - 32, buf, 24) &&
+      !memcmp(buf, "APETAGEX", 8)) {
+    // footer: version, size of items and footer, item count, flags
+    uint32_t size = le32(buf + 12);
+    uint32_t count = le32(buf + 16);
+    boolean hasHeader = le32(buf + 20) & 0x80000000;
+    uint32_t footer = end - 32;
+    if ((size >= 32) &&
+        (size + (hasHeader ? 32 : 0) <= end - meta->audioStart)) {
+      uint32_t pos = end - size;
+      end = pos - (hasHeader ? 32 : 0);
+      // items: value length, flags, key and a null, then the value
+      for (; count && (pos + 9 <= footer); count--) {
+        size_t n = footer - pos;
+        if (n > sizeof(buf))
+          n = sizeof(buf);
+        if (!readAt(source, pos, buf, n))
+          break;
+        uint32_t valueLen = le32(buf);
+        const uint8_t *nul = (const uint8_t *)memchr(buf + 8, 0, n - 8);
+        if (!nul)
+          break; // a key longer than we can hold, give up on the rest
+        uint32_t value = pos + (nul + 1 - buf);
+        char *dst = commentField(meta, buf + 8, nul - (buf + 8));
+        if (dst && !dst[0]) {
+          n = (valueLen < sizeof(buf)) ? valueLen : sizeof(buf);
+          if (readAt(source, value, buf, n))
+            copyTag(dst, buf, n, 3);
+        }
+        pos = value + valueLen;
+      }
+    }
   }
 
-  // fill it up!
-  while (playingMusic && readyForData()) {
-    feedBuffer();
+  // title, artist and album are 30 byte fields after "TAG"
+  if (id3v1) {
+    uint8_t field[30];
+    for (uint8_t f = 0; f < 3; f++) {
+      char *dst = metaField(meta, f);
+      if (!dst[0] && readAt(source, id3v1 + 3 + 30 * f, field, 30))
+        copyTag(dst, field, 30, 0);
+    }
   }
+  meta->audioEnd = end;
+}
 
-  // ok going forward, we can use the IRQ
-  interrupts();
+static void readMP3(Adafruit_VS1053_Source *source, vs1053_metadata_t *meta) {
+  readTrailingTags(source, meta);
 
-  return true;
+  // first frame header plus room for a Xing or VBRI header after it
+  uint8_t buf[56];
+  uint32_t rate, frames, bytes;
+  uint16_t samplesPerFrame, kbps;
+  uint8_t xing, toc;
+  if (!readAt(source, meta->audioStart, buf, sizeof(buf)) ||
+      !mp3FrameInfo(buf, &rate, &samplesPerFrame, &xing, &kbps))
+    return;
+  meta->sampleRate = rate;
+  meta->channels = (((buf[3] >> 6) & 3) == 3) ? 1 : 2;
+
+  mp3VBRInfo(buf, xing, &frames, &bytes, &toc);
+  if (frames) {
+    meta->durationMs = ((uint64_t)frames * samplesPerFrame * 1000) / rate;
+    if (bytes && meta->durationMs)
+      meta->bitrate = ((uint64_t)bytes * 8) / meta->durationMs;
+  } else if (kbps) {
+    // constant bitrate, kbit/s is the same as bits per ms
+    meta->bitrate = kbps;
+    meta->durationMs =
+        ((uint64_t)(meta->audioEnd - meta->audioStart) * 8) / kbps;
+  }
 }
 
-void Adafruit_VS1053_FilePlayer::feedBuffer(void) {
-  if (usingInterrupts)
-    noInterrupts();
-  // dont run twice in case interrupts collided
-  // This isn't a perfect lock as it may lose one feedBuffer request if
-  // an interrupt occurs before feedBufferLock is reset to false. This
-  // may cause a glitch in the audio but at least it will not corrupt
-  // state.
-  if (feedBufferLock) {
-    interrupts();
+// Vorbis comments, as used by FLAC and Ogg Vorbis: little endian lengths,
+// a vendor string, then "KEY=value" strings
+static void readVorbisComments(Adafruit_VS1053_Source *source, uint32_t pos,
+                               uint32_t end, vs1053_metadata_t *meta) {
+  uint8_t buf[VS1053_TAGLEN + 8]; // room for "ARTIST=" and a full value
+  if ((pos + 4 > end) || !readAt(source, pos, buf, 4))
     return;
+  pos += 4 + le32(buf); // vendor
+  if ((pos + 4 > end) || !readAt(source, pos, buf, 4))
+    return;
+  uint32_t count = le32(buf);
+  pos += 4;
+
+  for (; count && (pos + 4 <= end); count--) {
+    if (!readAt(source, pos, buf, 4))
+      return;
+    uint32_t len = le32(buf);
+    pos += 4;
+    if (len > end - pos)
+      return;
+    size_t n = (len < sizeof(buf)) ? len : sizeof(buf);
+    if (n && readAt(source, pos, buf, n)) {
+      const uint8_t *eq = (const uint8_t *)memchr(buf, '=', n);
+      char *dst = eq ? commentField(meta, buf, eq - buf) : NULL;
+      if (dst && !dst[0])
+        copyTag(dst, eq + 1, n - (eq + 1 - buf), 3);
+    }
+    pos += len;
   }
-  feedBufferLock = true;
-  interrupts();
+}
 
-  feedBuffer_noLock();
+// "fLaC" then metadata blocks, the audio frames follow the last one
+static void readFLAC(Adafruit_VS1053_Source *source, vs1053_metadata_t *meta) {
+  uint8_t buf[18];
+  uint32_t pos = meta->audioStart + 4;
+  boolean last = false;
+
+  while (!last) {
+    if (!readAt(source, pos, buf, 4))
+      return;
+    last = buf[0] & 0x80;
+    uint8_t type = buf[0] & 0x7F;
+    uint32_t len = ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3];
+    pos += 4;
+    if (type == 127)
+      return; // invalid, not really FLAC
+
+    if ((type == 0) && (len >= 18) && readAt(source, pos, buf, 18)) {
+      // STREAMINFO: 20 bit sample rate, 3 bit channels - 1, 5 bit sample
+      // size - 1, 36 bit total samples
+      meta->sampleRate = ((uint32_t)buf[10] << 12) |
+                         ((uint32_t)buf[11] << 4) | (buf[12] >> 4);
+      meta->channels = ((buf[12] >> 1) & 7) + 1;
+      uint64_t samples = ((uint64_t)(buf[13] & 0x0F) << 32) | be32(buf + 14);
+      if (meta->sampleRate)
+        meta->durationMs = (samples * 1000) / meta->sampleRate;
+    } else if (type == 4) {
+      readVorbisComments(source, pos, pos + len, meta);
+    }
+    pos += len;
+  }
+  meta->audioStart = pos;
+}
 
-  feedBufferLock = false;
+// The granule position of the last Ogg page is the total sample count.
+// Pages are at most about 64KB but nearly always much less, so only the
+// end of the file is searched
+static uint32_t oggSamples(Adafruit_VS1053_Source *source, uint32_t start,
+                           uint32_t end) {
+  uint8_t buf[64];
+  uint32_t limit = (end - start > 16384) ? end - 16384 : start;
+  uint32_t pos = end;
+
+  while (pos > limit) {
+    // step back, overlapping so a capture pattern split between two reads
+    // is still found
+    uint32_t from = (pos - limit > sizeof(buf)) ? pos - sizeof(buf) : limit;
+    size_t n = pos - from;
+    if (!readAt(source, from, buf, n))
+      return 0;
+    for (int i = n - 4; i >= 0; i--) {
+      if (!memcmp(buf + i, "OggS", 4)) {
+        uint8_t granule[4];
+        if (!readAt(source, from + i + 6, granule, 4))
+          return 0;
+        return le32(granule);
+      }
+    }
+    if (from == limit)
+      break;
+    pos = from + 3;
+  }
+  return 0;
 }
 
-void Adafruit_VS1053_FilePlayer::feedBuffer_noLock(void) {
-  if ((!playingMusic) // paused or stopped
-      || (!currentTrack) || (!readyForData())) {
-    return; // paused or stopped
+// The Vorbis identification header is alone on the first page and the
+// comment header starts the second
+static void readOgg(Adafruit_VS1053_Source *source, vs1053_metadata_t *meta) {
+  uint8_t buf[28];
+  uint32_t pos = meta->audioStart;
+
+  for (uint8_t page = 0; page < 2; page++) {
+    if (!readAt(source, pos, buf, 27) || memcmp(buf, "OggS", 4))
+      return;
+    // the page body length is the sum of the segment table
+    uint8_t segments = buf[26];
+    uint32_t body = pos + 27 + segments;
+    uint32_t len = 0;
+    for (uint8_t i = 0; i < segments;) {
+      uint8_t n = segments - i;
+      if (n > sizeof(buf))
+        n = sizeof(buf);
+      if (!readAt(source, pos + 27 + i, buf, n))
+        return;
+      for (uint8_t j = 0; j < n; j++)
+        len += buf[j];
+      i += n;
+    }
+
+    if (page == 0) {
+      // type, "vorbis", version, channels, sample rate, max/nominal/min
+      // bitrate
+      if (!readAt(source, body, buf, 28) || (buf[0] != 1) ||
+          memcmp(buf + 1, "vorbis", 6))
+        return;
+      meta->channels = buf[11];
+      meta->sampleRate = le32(buf + 12);
+      int32_t nominal = le32(buf + 20);
+      if (nominal > 0)
+        meta->bitrate = nominal / 1000;
+    } else {
+      if (!readAt(source, body, buf, 7) || (buf[0] != 3) ||
+          memcmp(buf + 1, "vorbis", 6))
+        return;
+      // a comment header that runs onto the next page stops at its end
+      readVorbisComments(source, body + 7, body + len, meta);
+    }
+    pos = body + len;
   }
 
-  // Feed the hungry buffer! :)
-  while (readyForData()) {
-    // Read some audio data from the SD card file
-    int bytesread = currentTrack.read(mp3buffer, VS1053_DATABUFFERLEN);
-
-    if (bytesread == 0) {
-      // must be at the end of the file
-      if (_loopPlayback) {
-        // play in loop
-        if (isMP3File(currentTrack.name())) {
-          currentTrack.seek(mp3_ID3Jumper(currentTrack));
-        } else {
-          currentTrack.seek(0);
-        }
-      } else {
-        // wrap it up!
-        playingMusic = false;
-        currentTrack.close();
-        break;
+  if (meta->sampleRate) {
+    uint32_t samples = oggSamples(source, meta->audioStart, meta->audioEnd);
+    meta->durationMs = ((uint64_t)samples * 1000) / meta->sampleRate;
+  }
+}
+
+// "RIFF" size "WAVE" then chunks, the samples are in the "data" chunk
+static void readWAV(Adafruit_VS1053_Source *source, vs1053_metadata_t *meta) {
+  uint8_t buf[16];
+  uint32_t pos = meta->audioStart + 12;
+  uint32_t byteRate = 0;
+
+  while (readAt(source, pos, buf, 8)) {
+    uint32_t len = le32(buf + 4);
+    pos += 8;
+    if (!memcmp(buf, "fmt ", 4)) {
+      // format, channels, sample rate, byte rate
+      if ((len < 16) || !readAt(source, pos, buf, 16))
+        return;
+      meta->channels = buf[2];
+      meta->sampleRate = le32(buf + 4);
+      byteRate = le32(buf + 8);
+      meta->blockAlign = buf[12] | (buf[13] << 8);
+      if ((buf[0] == 1) && (buf[1] == 0)) // linear PCM
+        meta->bitsPerSample = buf[14];
+    } else if (!memcmp(buf, "data", 4)) {
+      meta->audioStart = pos;
+      // recorders that can't seek back leave the length at 0 or ~0
+      if (len && (len < meta->audioEnd - pos))
+        meta->audioEnd = pos + len;
+      if (byteRate) {
+        meta->bitrate = (byteRate * 8) / 1000;
+        meta->durationMs =
+            ((uint64_t)(meta->audioEnd - meta->audioStart) * 1000) / byteRate;
       }
+      return;
     }
+    pos += len + (len & 1); // chunks are padded to an even length
+  }
+}
 
-    playData(mp3buffer, bytesread);
+boolean Adafruit_VS1053_FilePlayer::readMetadata(Adafruit_VS1053_Source *source,
+                                                 vs1053_metadata_t *meta) {
+  memset(meta, 0, sizeof(*meta));
+  if (!source)
+    return false;
+  meta->audioEnd = source->size();
+
+  uint8_t buf[12];
+  if (!readAt(source, 0, buf, 10))
+    return false;
+  meta->audioStart = id3v2Length(buf);
+  if (meta->audioStart)
+    readID3v2(source, buf, meta);
+  if (meta->audioEnd < meta->audioStart)
+    meta->audioEnd = meta->audioStart; // size unknown
+
+  // the format is decided by what's there, not by the file name
+  if (readAt(source, meta->audioStart, buf, 12)) {
+    meta->format = sniffFormat(buf);
+    if (meta->audioStart && (meta->format == VS1053_FORMAT_UNKNOWN))
+      meta->format = VS1053_FORMAT_MP3;
+
+    switch (meta->format) {
+    case VS1053_FORMAT_FLAC:
+      readFLAC(source, meta);
+      break;
+    case VS1053_FORMAT_OGG:
+      readOgg(source, meta);
+      break;
+    case VS1053_FORMAT_WAV:
+      readWAV(source, meta);
+      break;
+    case VS1053_FORMAT_MP3:
+    case VS1053_FORMAT_UNKNOWN:
+      readMP3(source, meta); // MP3s may have junk before the first frame
+      break;
+    default:
+      break;
+    }
   }
+
+  if (!meta->bitrate && meta->durationMs)
+    meta->bitrate =
+        ((uint64_t)(meta->audioEnd - meta->audioStart) * 8) / meta->durationMs;
+
+  source->seek(meta->audioStart);
+  return true;
 }
 
+/***************************************************************/
+
 // get current playback speed. 0 or 1 indicates normal speed
 uint16_t Adafruit_VS1053_FilePlayer::getPlaySpeed() {
-  if (usingInterrupts)
-    noInterrupts();
-  sciWrite(VS1053_SCI_WRAMADDR, VS1053_PARA_PLAYSPEED);
-  uint16_t speed = sciRead(VS1053_SCI_WRAM);
-  interrupts();
-  return speed;
+  return wramRead(VS1053_PARA_PLAYSPEED);
 }
 
 // set playback speed: 0 or 1 for normal speed, 2 for 2x, 3 for 3x, etc.
 void Adafruit_VS1053_FilePlayer::setPlaySpeed(uint16_t speed) {
-  if (usingInterrupts)
-    noInterrupts();
-  sciWrite(VS1053_SCI_WRAMADDR, VS1053_PARA_PLAYSPEED);
-  sciWrite(VS1053_SCI_WRAM, speed);
-  interrupts();
+  wramWrite(VS1053_PARA_PLAYSPEED, speed);
 }
 
 /***************************************************************/
@@ -388,7 +2661,7 @@ void Adafruit_VS1053::applyPatch(const uint16_t *patch, uint16_t patchsize) {
 
   // Serial.print("Patch size: "); Serial.println(patchsize);
   while (i < patchsize) {
-    uint16_t addr, n, val;
+    uint16_t addr, n;
 
     addr = pgm_read_word(patch++);
     n = pgm_read_word(patch++);
@@ -397,17 +2670,13 @@ void Adafruit_VS1053::applyPatch(const uint16_t *patch, uint16_t patchsize) {
     // Serial.println(addr, HEX);
     if (n & 0x8000U) { // RLE run, replicate n samples
       n &= 0x7FFF;
-      val = pgm_read_word(patch++);
+      sciWriteRun(addr, patch, n, SCI_PROGMEM | SCI_REPEAT);
+      patch++;
       i++;
-      while (n--) {
-        sciWrite(addr, val);
-      }
     } else { // Copy run, copy n samples
-      while (n--) {
-        val = pgm_read_word(patch++);
-        i++;
-        sciWrite(addr, val);
-      }
+      sciWriteRun(addr, patch, n, SCI_PROGMEM);
+      patch += n;
+      i += n;
     }
   }
 }
@@ -425,7 +2694,9 @@ uint16_t Adafruit_VS1053::loadPlugin(char *plugname) {
       (plugin.read() != 'H'))
     return 0xFFFF;
 
-  uint16_t type;
+  int type;
+  uint16_t words[VS1053_PLUGINBUFLEN];
+  uint8_t *bytes = (uint8_t *)words;
 
   // Serial.print("Patch size: "); Serial.println(patchsize);
   while ((type = plugin.read()) >= 0) {
@@ -434,17 +2705,13 @@ uint16_t Adafruit_VS1053::loadPlugin(char *plugname) {
 
     // Serial.print("type: "); Serial.println(type, HEX);
 
-    if (type >= 4) {
+    // record header: big endian length in bytes and address
+    if ((type >= 4) || (plugin.read(bytes, 4) != 4)) {
       plugin.close();
       return 0xFFFF;
     }
-
-    len = plugin.read();
-    len <<= 8;
-    len |= plugin.read() & ~1;
-    addr = plugin.read();
-    addr <<= 8;
-    addr |= plugin.read();
+    len = ((bytes[0] << 8) | bytes[1]) & ~1;
+    addr = (bytes[2] << 8) | bytes[3];
     // Serial.print("len: "); Serial.print(len);
     // Serial.print(" addr: $"); Serial.println(addr, HEX);
 
@@ -454,28 +2721,186 @@ uint16_t Adafruit_VS1053::loadPlugin(char *plugname) {
       return addr;
     }
 
-    // set address
+    // set address, it moves on by itself as the data is written
     sciWrite(VS1053_REG_WRAMADDR, addr + offsets[type]);
-    // write data
-    do {
-      uint16_t data;
-      data = plugin.read();
-      data <<= 8;
-      data |= plugin.read();
-      sciWrite(VS1053_REG_WRAM, data);
-    } while ((len -= 2));
+    while (len) {
+      uint16_t n = min(len, (uint16_t)sizeof(words));
+      if (plugin.read(bytes, n) != n) {
+        plugin.close();
+        return 0xFFFF;
+      }
+      // big endian in the file, each word is read before it's overwritten
+      for (uint16_t w = 0; w < n / 2; w++)
+        words[w] = (bytes[2 * w] << 8) | bytes[2 * w + 1];
+      sciWriteMulti(VS1053_REG_WRAM, words, n / 2);
+      len -= n;
+    }
   }
 
   plugin.close();
   return 0xFFFF;
 }
 
+uint16_t Adafruit_VS1053::byteRate(void) {
+  return wramRead(VS1053_PARA_BYTERATE);
+}
+
+uint8_t Adafruit_VS1053::endFillByte(void) {
+  return wramRead(VS1053_PARA_ENDFILLBYTE) & 0xFF;
+}
+
+void Adafruit_VS1053::useTransport(Adafruit_VS1053_SDITransport *transport) {
+  sdiTransport = transport;
+}
+
+void Adafruit_VS1053::waitForTransport(void) {
+  if (sdiTransport) {
+    while (sdiTransport->busy())
+      ;
+  }
+}
+
+void Adafruit_VS1053::holdBus(void) {
+  // wait with interrupts on, the transport may need them to finish, then
+  // check a completion callback didn't start another one in between
+  while (true) {
+    waitForTransport();
+    if (usingInterrupts)
+      noInterrupts();
+    if (!sdiTransport || !sdiTransport->busy())
+      return;
+    interrupts();
+  }
+}
+
 boolean Adafruit_VS1053::readyForData(void) { return digitalRead(_dreq); }
 
 void Adafruit_VS1053::playData(uint8_t *buffer, uint8_t buffsiz) {
+  waitForTransport();
   spi_dev_data->write(buffer, buffsiz);
 }
 
+size_t Adafruit_VS1053::playDataBurst(uint8_t *buffer, size_t buffsiz) {
+  size_t sent = 0;
+
+  waitForTransport();
+
+  if (!readyForData())
+    return 0;
+
+  // DREQ high guarantees room for VS1053_DATABUFFERLEN bytes, so check it
+  // between chunks but only toggle DCS once for the whole burst
+  spi_dev_data->beginTransactionWithAssertingCS();
+  do {
+    size_t len = buffsiz - sent;
+    if (len > VS1053_DATABUFFERLEN)
+      len = VS1053_DATABUFFERLEN;
+    spi_dev_data->transfer(buffer + sent, len);
+    sent += len;
+  } while ((sent < buffsiz) && readyForData());
+  spi_dev_data->endTransactionWithDeassertingCS();
+
+  return sent;
+}
+
+void Adafruit_VS1053::startPCM(uint16_t rate, uint8_t channels) {
+  _pcmChannels = (channels == 2) ? 2 : 1;
+  uint8_t header[VS1053_WAVHEADERMAX];
+  uint8_t len = wavHeader(header, false, _pcmChannels, rate, 0xFFFFFFFF);
+
+  for (uint8_t sent = 0; sent < len; sent += VS1053_DATABUFFERLEN) {
+    while (!readyForData())
+      ;
+    playData(header + sent, ((len - sent) > VS1053_DATABUFFERLEN)
+                                ? VS1053_DATABUFFERLEN
+                                : (len - sent));
+  }
+  _pcmRate = rate;
+  _pcmSamples = 0;
+}
+
+size_t Adafruit_VS1053::playPCM(const int16_t *samples, size_t count,
+                                boolean block) {
+  size_t sent = 0;
+
+  if (!_pcmRate)
+    return 0;
+  waitForTransport();
+
+  while (sent < count) {
+    if (!readyForData()) {
+      if (!block)
+        break;
+      continue;
+    }
+
+    // like playDataBurst(), but the samples are copied out little endian
+    // since the SPI transfer overwrites what it sends
+    spi_dev_data->beginTransactionWithAssertingCS();
+    do {
+      size_t n = count - sent;
+      if (n > VS1053_DATABUFFERLEN / 2)
+        n = VS1053_DATABUFFERLEN / 2;
+      for (uint8_t i = 0; i < n; i++) {
+        uint16_t sample = samples[sent + i];
+        mp3buffer[2 * i] = sample;
+        mp3buffer[2 * i + 1] = sample >> 8;
+      }
+      spi_dev_data->transfer(mp3buffer, n * 2);
+      sent += n;
+    } while ((sent < count) && readyForData());
+    spi_dev_data->endTransactionWithDeassertingCS();
+  }
+
+  if (sent) {
+    uint32_t now = micros();
+    int32_t queued = pcmQueued(now);
+    if (queued <= 0) {
+      // ran dry (or just started), the clock starts again from here
+      _pcmStart = now;
+      _pcmSamples = 0;
+    } else if ((now - _pcmStart) > 1000000) {
+      // keep the numbers small, and clear of micros() wrapping
+      _pcmStart += 1000000;
+      _pcmSamples -= (uint32_t)_pcmRate * _pcmChannels;
+    }
+    _pcmSamples += sent;
+  }
+  return sent;
+}
+
+void Adafruit_VS1053::endPCM(void) {
+  if (!_pcmRate)
+    return;
+  // flush the last samples through the decoder
+  memset(mp3buffer, endFillByte(), VS1053_DATABUFFERLEN);
+  for (uint16_t sent = 0; sent < VS1053_ENDFILLLEN;
+       sent += VS1053_DATABUFFERLEN) {
+    while (!readyForData())
+      ;
+    uint8_t len = ((VS1053_ENDFILLLEN - sent) > VS1053_DATABUFFERLEN)
+                      ? VS1053_DATABUFFERLEN
+                      : (VS1053_ENDFILLLEN - sent);
+    playData(mp3buffer, len);
+  }
+  _pcmRate = 0;
+}
+
+uint32_t Adafruit_VS1053::pcmLatency(void) {
+  int32_t queued = pcmQueued(micros());
+  return (queued > 0) ? queued : 0;
+}
+
+// Microseconds of audio sent but not yet played, going by the wall clock
+// since the stream (re)started. Negative once the decoder has run dry.
+int32_t Adafruit_VS1053::pcmQueued(uint32_t now) {
+  if (!_pcmRate)
+    return 0;
+  uint32_t sent =
+      (uint64_t)(_pcmSamples / _pcmChannels) * 1000000 / _pcmRate;
+  return (int32_t)(sent - (now - _pcmStart));
+}
+
 void Adafruit_VS1053::setVolume(uint8_t left, uint8_t right) {
   // accepts values between 0 and 255 for left and right.
   uint16_t v;
@@ -483,8 +2908,7 @@ void Adafruit_VS1053::setVolume(uint8_t left, uint8_t right) {
   v <<= 8;
   v |= right;
 
-  if (usingInterrupts)
-    noInterrupts(); // cli();
+  holdBus(); // cli();
 
   sciWrite(VS1053_REG_VOLUME, v);
 
@@ -492,22 +2916,34 @@ void Adafruit_VS1053::setVolume(uint8_t left, uint8_t right) {
 }
 
 uint16_t Adafruit_VS1053::decodeTime() {
-  if (usingInterrupts)
-    noInterrupts();
+  holdBus();
   uint16_t t = sciRead(VS1053_REG_DECODETIME);
   interrupts(); // sei();
   return t;
 }
 
 void Adafruit_VS1053::softReset(void) {
+  startSoftReset();
+  delay(VS1053_SOFTRESETMS);
+  finishSoftReset();
+}
+
+void Adafruit_VS1053::startSoftReset(void) {
+  // go slow until we know what the clock multiplier is afterwards
+  setSPIClocks(VS1053_SCI_RESETCLOCK, sdiClock());
   sciWrite(VS1053_REG_MODE, VS1053_MODE_SM_SDINEW | VS1053_MODE_SM_RESET);
-  delay(100);
+}
+
+void Adafruit_VS1053::finishSoftReset(void) {
+  clockChanged(sciRead(VS1053_REG_CLOCKF));
 }
 
 void Adafruit_VS1053::reset() {
   // TODO:
   // http://www.vlsi.fi/player_vs1011_1002_1003/modularplayer/vs10xx_8c.html#a3
   // hardware reset
+  _shadowValid = 0;
+  setSPIClocks(VS1053_SCI_RESETCLOCK, sdiClock());
   if (_reset >= 0) {
     digitalWrite(_reset, LOW);
     delay(100);
@@ -531,19 +2967,11 @@ uint8_t Adafruit_VS1053::begin(void) {
 
   pinMode(_dreq, INPUT);
 
-  if (useHardwareSPI) {
-    spi_dev_ctrl = new Adafruit_SPIDevice(_cs, 250000, SPI_BITORDER_MSBFIRST,
-                                          SPI_MODE0, &SPI);
-    spi_dev_data = new Adafruit_SPIDevice(_dcs, 8000000, SPI_BITORDER_MSBFIRST,
-                                          SPI_MODE0, &SPI);
-  } else {
-    spi_dev_ctrl = new Adafruit_SPIDevice(_cs, _clk, _miso, _mosi, 250000,
-                                          SPI_BITORDER_MSBFIRST, SPI_MODE0);
-    spi_dev_data = new Adafruit_SPIDevice(_dcs, _clk, _miso, _mosi, 8000000,
-                                          SPI_BITORDER_MSBFIRST, SPI_MODE0);
-  }
-  spi_dev_ctrl->begin();
-  spi_dev_data->begin();
+  // the clocks are raised once reset() has set the clock multiplier
+  _sciClock = VS1053_SCI_RESETCLOCK;
+  _sdiClock = min((uint32_t)(VS1053_XTALI / 4), (uint32_t)VS1053_SPI_MAXCLOCK);
+  spi_dev_ctrl = newSPIDevice(_cs, _sciClock);
+  spi_dev_data = newSPIDevice(_dcs, _sdiClock);
 
   reset();
 
@@ -569,6 +2997,20 @@ uint16_t Adafruit_VS1053::recordedReadWord(void) {
   return sciRead(VS1053_REG_HDAT0);
 }
 
+void Adafruit_VS1053::recordedRead(uint8_t *buffer, uint16_t words) {
+  uint8_t cmd[2];
+
+  holdBus();
+  while (words--) {
+    // HDAT0 comes back high byte first, straight into place
+    cmd[0] = VS1053_SCI_READ;
+    cmd[1] = VS1053_REG_HDAT0;
+    spi_dev_ctrl->write_then_read(cmd, 2, buffer, 2);
+    buffer += 2;
+  }
+  interrupts();
+}
+
 boolean Adafruit_VS1053::prepareRecordOgg(char *plugname) {
   sciWrite(VS1053_REG_CLOCKF, 0xC000); // set max clock
   delay(1);
@@ -584,8 +3026,7 @@ boolean Adafruit_VS1053::prepareRecordOgg(char *plugname) {
 
   sciWrite(VS1053_SCI_AIADDR, 0);
   // disable all interrupts except SCI
-  sciWrite(VS1053_REG_WRAMADDR, VS1053_INT_ENABLE);
-  sciWrite(VS1053_REG_WRAM, 0x02);
+  wramWrite(VS1053_INT_ENABLE, 0x02);
 
   int pluginStartAddr = loadPlugin(plugname);
   if (pluginStartAddr == 0xFFFF)
@@ -600,6 +3041,46 @@ boolean Adafruit_VS1053::prepareRecordOgg(char *plugname) {
 
 void Adafruit_VS1053::stopRecordOgg(void) { sciWrite(VS1053_SCI_AICTRL3, 1); }
 
+void Adafruit_VS1053::startRecordPCM(uint16_t rate, uint8_t channels,
+                                     boolean mic) {
+  startRecordADC(rate, channels, mic, true);
+}
+
+void Adafruit_VS1053::startRecordADPCM(uint16_t rate, uint8_t channels,
+                                       boolean mic) {
+  startRecordADC(rate, channels, mic, false);
+}
+
+void Adafruit_VS1053::stopRecordPCM(void) { softReset(); }
+
+// The chip's own encoder, datasheet 'PCM/ADPCM Recording'. It picks up its
+// settings from the AICTRL registers when SM_RESET is set with SM_ADPCM.
+void Adafruit_VS1053::startRecordADC(uint16_t rate, uint8_t channels,
+                                     boolean mic, boolean pcm) {
+  sciWrite(VS1053_REG_CLOCKF, 0xC000); // 48kHz needs the full clock
+  sciWrite(VS1053_REG_BASS, 0);        // and no bass/treble
+  sciWrite(VS1053_SCI_AICTRL0, rate);
+  /* Rec level: 1024 = 1. If 0, use AGC */
+  sciWrite(VS1053_SCI_AICTRL1, 1024);
+  /* Maximum AGC level: 1024 = 1. Only used if SCI_AICTRL1 is set to 0. */
+  sciWrite(VS1053_SCI_AICTRL2, 0);
+  // bits 2:0 are 0 for joint stereo or 2 for the left channel, bit 3
+  // picks linear PCM over IMA ADPCM
+  sciWrite(VS1053_SCI_AICTRL3, ((channels == 2) ? 0 : 2) | (pcm ? _BV(3) : 0));
+
+  uint16_t mode =
+      VS1053_MODE_SM_SDINEW | VS1053_MODE_SM_ADPCM | VS1053_MODE_SM_RESET;
+  if (!mic)
+    mode |= VS1053_MODE_SM_LINE1;
+  // go slow until the reset is done, like softReset()
+  setSPIClocks(VS1053_SCI_RESETCLOCK, sdiClock());
+  sciWrite(VS1053_REG_MODE, mode);
+  delay(1);
+  while (!readyForData())
+    ;
+  clockChanged(sciRead(VS1053_REG_CLOCKF));
+}
+
 void Adafruit_VS1053::startRecordOgg(boolean mic) {
   /* Set VS1053 mode bits as instructed in the VS1053b Ogg Vorbis Encoder
      manual. Note: for microphone input, leave SMF_LINE1 unset! */
@@ -627,50 +3108,43 @@ void Adafruit_VS1053::GPIO_pinMode(uint8_t i, uint8_t dir) {
   if (i > 7)
     return;
 
-  sciWrite(VS1053_REG_WRAMADDR, VS1053_GPIO_DDR);
-  uint16_t ddr = sciRead(VS1053_REG_WRAM);
+  uint16_t ddr = wramReadCached(VS1053_GPIO_DDR);
 
   if (dir == INPUT)
     ddr &= ~_BV(i);
   if (dir == OUTPUT)
     ddr |= _BV(i);
 
-  sciWrite(VS1053_REG_WRAMADDR, VS1053_GPIO_DDR);
-  sciWrite(VS1053_REG_WRAM, ddr);
+  wramWrite(VS1053_GPIO_DDR, ddr);
 }
 
 void Adafruit_VS1053::GPIO_digitalWrite(uint8_t val) {
-  sciWrite(VS1053_REG_WRAMADDR, VS1053_GPIO_ODATA);
-  sciWrite(VS1053_REG_WRAM, val);
+  wramWrite(VS1053_GPIO_ODATA, val);
 }
 
 void Adafruit_VS1053::GPIO_digitalWrite(uint8_t i, uint8_t val) {
   if (i > 7)
     return;
 
-  sciWrite(VS1053_REG_WRAMADDR, VS1053_GPIO_ODATA);
-  uint16_t pins = sciRead(VS1053_REG_WRAM);
+  uint16_t pins = wramReadCached(VS1053_GPIO_ODATA);
 
   if (val == LOW)
     pins &= ~_BV(i);
   if (val == HIGH)
     pins |= _BV(i);
 
-  sciWrite(VS1053_REG_WRAMADDR, VS1053_GPIO_ODATA);
-  sciWrite(VS1053_REG_WRAM, pins);
+  wramWrite(VS1053_GPIO_ODATA, pins);
 }
 
 uint16_t Adafruit_VS1053::GPIO_digitalRead(void) {
-  sciWrite(VS1053_REG_WRAMADDR, VS1053_GPIO_IDATA);
-  return sciRead(VS1053_REG_WRAM) & 0xFF;
+  return wramRead(VS1053_GPIO_IDATA) & 0xFF;
 }
 
 boolean Adafruit_VS1053::GPIO_digitalRead(uint8_t i) {
   if (i > 7)
     return 0;
 
-  sciWrite(VS1053_REG_WRAMADDR, VS1053_GPIO_IDATA);
-  uint16_t val = sciRead(VS1053_REG_WRAM);
+  uint16_t val = wramRead(VS1053_GPIO_IDATA);
   if (val & _BV(i))
     return true;
   return false;
@@ -678,6 +3152,7 @@ boolean Adafruit_VS1053::GPIO_digitalRead(uint8_t i) {
 
 uint16_t Adafruit_VS1053::sciRead(uint8_t addr) {
   uint8_t buffer[2] = {VS1053_SCI_READ, addr};
+  waitForTransport();
   spi_dev_ctrl->write_then_read(buffer, 2, buffer, 2);
   return (uint16_t(buffer[0]) << 8) | uint16_t(buffer[1]);
 }
@@ -685,7 +3160,257 @@ uint16_t Adafruit_VS1053::sciRead(uint8_t addr) {
 void Adafruit_VS1053::sciWrite(uint8_t addr, uint16_t data) {
   uint8_t buffer[4] = {VS1053_SCI_WRITE, addr, uint8_t(data >> 8),
                        uint8_t(data & 0xFF)};
+  waitForTransport();
   spi_dev_ctrl->write(buffer, 4);
+  sciWritten(addr, data);
+}
+
+uint32_t Adafruit_VS1053::sciClock(void) { return _sciClock; }
+
+uint32_t Adafruit_VS1053::sdiClock(void) { return _sdiClock; }
+
+Adafruit_SPIDevice *Adafruit_VS1053::newSPIDevice(int8_t cs, uint32_t clock) {
+  Adafruit_SPIDevice *dev;
+  if (useHardwareSPI) {
+    dev = new Adafruit_SPIDevice(cs, clock, SPI_BITORDER_MSBFIRST, SPI_MODE0,
+                                 &SPI);
+  } else {
+    dev = new Adafruit_SPIDevice(cs, _clk, _miso, _mosi, clock,
+                                 SPI_BITORDER_MSBFIRST, SPI_MODE0);
+  }
+  dev->begin();
+  return dev;
+}
+
+// The SPI devices have their clock fixed when made, so changing it means
+// making new ones. This holds and lets go of the bus itself, so it (and
+// anything writing CLOCKF) mustn't be called with the bus held
+void Adafruit_VS1053::setSPIClocks(uint32_t sciHz, uint32_t sdiHz) {
+  if ((sciHz == _sciClock) && (sdiHz == _sdiClock))
+    return;
+  holdBus();
+  if (sciHz != _sciClock) {
+    delete spi_dev_ctrl;
+    spi_dev_ctrl = newSPIDevice(_cs, sciHz);
+    _sciClock = sciHz;
+  }
+  if (sdiHz != _sdiClock) {
+    delete spi_dev_data;
+    spi_dev_data = newSPIDevice(_dcs, sdiHz);
+    _sdiClock = sdiHz;
+  }
+  interrupts();
+}
+
+// Datasheet 'SPI Timing': SCI reads are good up to CLKI/7 and SDI up to
+// CLKI/4. CLKI is XTALI times the SC_MULT multiplier, see 'SCI_CLOCKF'.
+// SC_ADD only kicks in while decoding, so it isn't counted.
+void Adafruit_VS1053::clockChanged(uint16_t clockf) {
+  // SC_MULT 0 is 1.0x, then 2.0x to 5.0x in steps of 0.5, in halves
+  static const uint8_t mult[8] = {2, 4, 5, 6, 7, 8, 9, 10};
+  uint16_t freq = clockf & 0x7FF;
+  uint32_t xtali = freq ? (freq * 4000UL + 8000000UL) : VS1053_XTALI;
+  uint32_t clki = (xtali * mult[(clockf >> 13) & 7]) / 2;
+  uint32_t sciHz = min(clki / 7, (uint32_t)VS1053_SPI_MAXCLOCK);
+  uint32_t sdiHz = min(clki / 4, (uint32_t)VS1053_SPI_MAXCLOCK);
+  if ((sciHz == _sciClock) && (sdiHz == _sdiClock))
+    return;
+
+  // DREQ is low while the clock switches over
+  uint32_t start = micros();
+  while (!readyForData() && ((micros() - start) < 1000))
+    ;
+  setSPIClocks(sciHz, sdiHz);
+}
+
+// _shadow slots, registers first then WRAM words
+static int8_t sciShadowSlot(uint8_t addr) {
+  switch (addr) {
+  case VS1053_REG_MODE:
+    return 0;
+  case VS1053_REG_BASS:
+    return 1;
+  case VS1053_REG_CLOCKF:
+    return 2;
+  case VS1053_REG_VOLUME:
+    return 3;
+  }
+  return -1;
+}
+
+static int8_t wramShadowSlot(uint16_t addr) {
+  switch (addr) {
+  case VS1053_GPIO_DDR:
+    return 4;
+  case VS1053_GPIO_ODATA:
+    return 5;
+  }
+  return -1;
+}
+
+// Keep the shadows in step with a write that has just been sent
+void Adafruit_VS1053::sciWritten(uint8_t addr, uint16_t data) {
+  int8_t slot = sciShadowSlot(addr);
+  if ((addr == VS1053_REG_MODE) && (data & VS1053_MODE_SM_RESET)) {
+    _shadowValid = 0; // everything goes back to its default
+  } else if (slot >= 0) {
+    // SM_CANCEL clears itself when the decoder is done
+    if (addr == VS1053_REG_MODE)
+      data &= ~VS1053_MODE_SM_CANCEL;
+    _shadow[slot] = data;
+    _shadowValid |= _BV(slot);
+  } else if (addr == VS1053_REG_WRAM) {
+    // WRAMADDR isn't tracked, so this could have been a GPIO register
+    _shadowValid &= ~(_BV(wramShadowSlot(VS1053_GPIO_DDR)) |
+                      _BV(wramShadowSlot(VS1053_GPIO_ODATA)));
+  } else if (addr == VS1053_SCI_AIADDR) {
+    _shadowValid = 0; // a plugin may change anything
+  }
+
+  if (addr == VS1053_REG_CLOCKF)
+    clockChanged(data);
+}
+
+// Write words to one register with XCS held low throughout, datasheet
+// 'SCI Multiple Write'
+void Adafruit_VS1053::sciTransfer(uint8_t addr, const uint16_t *data,
+                                  uint16_t n, uint8_t flags) {
+  uint8_t buffer[2] = {VS1053_SCI_WRITE, addr};
+  spi_dev_ctrl->beginTransactionWithAssertingCS();
+  spi_dev_ctrl->transfer(buffer, 2);
+  for (uint16_t i = 0; i < n; i++) {
+    // DREQ drops for a moment while each word is taken in
+    if (i) {
+      while (!readyForData())
+        ;
+    }
+    const uint16_t *p = (flags & SCI_REPEAT) ? data : data + i;
+    uint16_t word = (flags & SCI_PROGMEM) ? pgm_read_word(p) : *p;
+    buffer[0] = word >> 8;
+    buffer[1] = word & 0xFF;
+    spi_dev_ctrl->transfer(buffer, 2);
+  }
+  spi_dev_ctrl->endTransactionWithDeassertingCS();
+}
+
+uint16_t Adafruit_VS1053::sciReadCached(uint8_t addr) {
+  int8_t slot = sciShadowSlot(addr);
+  if ((slot >= 0) && (_shadowValid & _BV(slot)))
+    return _shadow[slot];
+
+  uint16_t data = sciRead(addr);
+  if (slot >= 0)
+    sciWritten(addr, data);
+  return data;
+}
+
+void Adafruit_VS1053::sciWriteMulti(uint8_t addr, const uint16_t *data,
+                                    uint16_t n) {
+  sciWriteRun(addr, data, n);
+}
+
+void Adafruit_VS1053::sciWriteRun(uint8_t addr, const uint16_t *data,
+                                  uint16_t n, uint8_t flags) {
+  if (!n)
+    return;
+  holdBus();
+  sciTransfer(addr, data, n, flags);
+  interrupts();
+
+  // only once the bus is free, a CLOCKF write makes new SPI devices
+  const uint16_t *last = (flags & SCI_REPEAT) ? data : data + n - 1;
+  sciWritten(addr, (flags & SCI_PROGMEM) ? pgm_read_word(last) : *last);
+}
+
+void Adafruit_VS1053::sciQueue(uint8_t addr, uint16_t data) {
+  if (_sciQueued == VS1053_SCIQUEUELEN)
+    sciFlush();
+  _sciQueueAddr[_sciQueued] = addr;
+  _sciQueueData[_sciQueued] = data;
+  _sciQueued++;
+}
+
+void Adafruit_VS1053::sciFlush(void) {
+  // a new CLOCKF means new SPI devices, and setSPIClocks() lets go of the
+  // bus, so that's left until the whole batch is out
+  boolean newClock = false;
+  uint16_t clockf = 0;
+
+  holdBus();
+  for (uint8_t i = 0; i < _sciQueued;) {
+    uint8_t addr = _sciQueueAddr[i];
+    uint8_t n = 1;
+    while ((i + n < _sciQueued) && (_sciQueueAddr[i + n] == addr))
+      n++;
+    sciTransfer(addr, _sciQueueData + i, n);
+    if (addr == VS1053_REG_CLOCKF) {
+      newClock = true;
+      clockf = _sciQueueData[i + n - 1];
+    } else {
+      sciWritten(addr, _sciQueueData[i + n - 1]);
+    }
+    i += n;
+  }
+  _sciQueued = 0;
+  interrupts();
+
+  if (newClock)
+    sciWritten(VS1053_REG_CLOCKF, clockf);
+}
+
+uint16_t Adafruit_VS1053::wramRead(uint16_t addr) {
+  holdBus();
+  sciWrite(VS1053_REG_WRAMADDR, addr);
+  uint16_t data = sciRead(VS1053_REG_WRAM);
+  interrupts();
+  return data;
+}
+
+void Adafruit_VS1053::wramWrite(uint16_t addr, uint16_t data) {
+  wramWriteBlock(addr, &data, 1);
+}
+
+uint16_t Adafruit_VS1053::wramReadCached(uint16_t addr) {
+  int8_t slot = wramShadowSlot(addr);
+  if ((slot >= 0) && (_shadowValid & _BV(slot)))
+    return _shadow[slot];
+
+  uint16_t data = wramRead(addr);
+  if (slot >= 0) {
+    _shadow[slot] = data;
+    _shadowValid |= _BV(slot);
+  }
+  return data;
+}
+
+void Adafruit_VS1053::wramReadBlock(uint16_t addr, uint16_t *data,
+                                    uint16_t n) {
+  // the address moves on by itself after each word
+  holdBus();
+  sciWrite(VS1053_REG_WRAMADDR, addr);
+  while (n--)
+    *data++ = sciRead(VS1053_REG_WRAM);
+  interrupts();
+}
+
+void Adafruit_VS1053::wramWriteBlock(uint16_t addr, const uint16_t *data,
+                                     uint16_t n) {
+  if (!n)
+    return;
+  holdBus();
+  sciWrite(VS1053_REG_WRAMADDR, addr);
+  sciTransfer(VS1053_REG_WRAM, data, n);
+  interrupts();
+
+  // note any GPIO registers the block covered
+  static const uint16_t shadowed[] = {VS1053_GPIO_DDR, VS1053_GPIO_ODATA};
+  for (uint8_t i = 0; i < sizeof(shadowed) / sizeof(shadowed[0]); i++) {
+    if ((shadowed[i] >= addr) && (shadowed[i] - addr < n)) {
+      int8_t slot = wramShadowSlot(shadowed[i]);
+      _shadow[slot] = data[shadowed[i] - addr];
+      _shadowValid |= _BV(slot);
+    }
+  }
 }
 
 void Adafruit_VS1053::sineTest(uint8_t n, uint16_t ms) {
@@ -62,6 +62,11 @@ typedef volatile RwReg PortReg; //!< Type definition/alias used to specify the
 #define VS1053_FILEPLAYER_PIN_INT                                              \
   5 //!< Allows useInterrupt to accept pins 0 to 4
 
+#ifndef VS1053_MAX_PLAYERS
+#define VS1053_MAX_PLAYERS                                                     \
+  4 //!< Number of file players that can be fed from interrupts at once
+#endif
+
 #define VS1053_SCI_READ 0x03  //!< Serial read address
 #define VS1053_SCI_WRITE 0x02 //!< Serial write address
 
@@ -112,8 +117,128 @@ typedef volatile RwReg PortReg; //!< Type definition/alias used to specify the
 #define VS1053_SCI_WRAMADDR 0x07 //!< Base address for RAM write/read
 
 #define VS1053_PARA_PLAYSPEED 0x1E04 //!< 0,1 = normal speed, 2 = 2x, 3 = 3x etc
+#define VS1053_PARA_BYTERATE                                                   \
+  0x1E05 //!< Average byte rate of the stream being decoded
+#define VS1053_PARA_ENDFILLBYTE                                                \
+  0x1E06 //!< Byte to send after the end of a stream to flush the decoder
 
 #define VS1053_DATABUFFERLEN 32 //!< Length of the data buffer
+#define VS1053_FIFOLEN 2048     //!< Size of the decoder's stream buffer
+#ifndef VS1053_SCIQUEUELEN
+#define VS1053_SCIQUEUELEN 8 //!< Register writes held by sciQueue()
+#endif
+#define VS1053_XTALI                                                           \
+  12288000 //!< Crystal frequency the chip assumes when SC_FREQ in CLOCKF is 0
+#define VS1053_SCI_RESETCLOCK                                                  \
+  250000 //!< SCI SPI clock used until the chip's clock multiplier is known
+#ifndef VS1053_SPI_MAXCLOCK
+#if defined(__AVR__)
+#define VS1053_SPI_MAXCLOCK                                                    \
+  (F_CPU / 2) //!< Fastest SPI clock the board and wiring can take
+#else
+#define VS1053_SPI_MAXCLOCK                                                    \
+  12000000 //!< Fastest SPI clock the board and wiring can take
+#endif
+#endif
+#ifndef VS1053_PLUGINBUFLEN
+#define VS1053_PLUGINBUFLEN 32 //!< Words read at a time by loadPlugin()
+#endif
+#define VS1053_SHADOWLEN                                                       \
+  6 //!< Registers and WRAM words kept for sciReadCached()/wramReadCached()
+
+#define VS1053_ENDFILLLEN                                                      \
+  2052 //!< Fill bytes to send after the end of a stream to flush the decoder
+#ifndef VS1053_SEEKINDEX_INTERVAL
+#define VS1053_SEEKINDEX_INTERVAL                                              \
+  10 //!< Seconds between seek index entries, at most 255
+#endif
+#ifndef VS1053_INDEXNAMELEN
+#define VS1053_INDEXNAMELEN 32 //!< Longest seek index file name, with the null
+#endif
+#ifndef VS1053_TAGLEN
+#define VS1053_TAGLEN 32 //!< Longest title/artist/album kept, with the null
+#endif
+
+#define VS1053_CANCELLEN                                                       \
+  2048 //!< Bytes to send waiting for SM_CANCEL to clear before soft resetting
+#define VS1053_SOFTRESETMS 100 //!< Time allowed for a soft reset, in ms
+
+#ifndef VS1053_FILEBUFFERLEN
+#if defined(ARDUINO_ARCH_AVR)
+#define VS1053_FILEBUFFERLEN 64 //!< Length of the file read-ahead buffer
+#else
+#define VS1053_FILEBUFFERLEN                                                   \
+  1024 //!< Length of the file read-ahead buffer, must be a power of 2 and at
+       //!< least VS1053_DATABUFFERLEN
+#endif
+#endif
+
+#ifndef VS1053_SECTORLEN
+#define VS1053_SECTORLEN 512 //!< Size of one SD card sector
+#endif
+#define VS1053_RECBUFLEN 1024 //!< Size of the chip's record buffer, in words
+#define VS1053_RECOVERFLOW                                                     \
+  (VS1053_RECBUFLEN - VS1053_RECBUFLEN / 8) //!< Words waiting (HDAT1) past
+                                            //!< which data may be lost
+#define VS1053_ADPCMBLOCKLEN                                                   \
+  256 //!< Bytes per channel in each IMA ADPCM block from the encoder
+#define VS1053_ADPCMBLOCKSAMPLES 505 //!< Samples in each IMA ADPCM block
+#define VS1053_WAVHEADERMAX 60       //!< Longest WAV header written, for ADPCM
+#ifndef VS1053_FADEINTERVAL
+#define VS1053_FADEINTERVAL 10 //!< Shortest time between fade steps, in ms
+#endif
+#ifndef VS1053_RECPOLLMIN
+#define VS1053_RECPOLLMIN                                                      \
+  1000 //!< Shortest time between record buffer polls, in microseconds
+#endif
+#ifndef VS1053_RECPOLLMAX
+#define VS1053_RECPOLLMAX                                                      \
+  50000 //!< Longest time between record buffer polls, in microseconds
+#endif
+
+/*!
+ * @brief Interface for sending SDI data without blocking the CPU, e.g. with
+ * DMA. Implementations drive DCS themselves and call transferComplete() from
+ * their completion interrupt once the last byte has been clocked out.
+ */
+class Adafruit_VS1053_SDITransport {
+public:
+  virtual ~Adafruit_VS1053_SDITransport() {}
+  /*!
+   * @brief Start sending a block of data to the SDI bus and return right away
+   * @param buffer Data to send, must stay valid until the transfer completes
+   * @param len Number of bytes to send, at most VS1053_DATABUFFERLEN
+   * @return Returns true if the transfer was started
+   */
+  virtual boolean startWrite(const uint8_t *buffer, size_t len) = 0;
+  /*!
+   * @brief Check if a transfer is still in flight
+   * @return Returns true while busy
+   */
+  virtual boolean busy(void) = 0;
+  /*!
+   * @brief Set the function to call when a transfer completes
+   * @param callback Function to call, or NULL for none
+   * @param arg Argument passed to the callback
+   */
+  void onComplete(void (*callback)(void *), void *arg) {
+    _callback = callback;
+    _callbackArg = arg;
+  }
+
+protected:
+  /*!
+   * @brief Call from the implementation when a transfer has completed
+   */
+  void transferComplete(void) {
+    if (_callback)
+      _callback(_callbackArg);
+  }
+
+private:
+  void (*_callback)(void *) = NULL;
+  void *_callbackArg = NULL;
+};
 
 /*!
  * Driver for the Adafruit VS1053
@@ -165,6 +290,88 @@ public:
    * @param data Data to write
    */
   void sciWrite(uint8_t addr, uint16_t data);
+  /*!
+   * @brief Reads a register the chip only changes when told to (MODE, BASS,
+   * CLOCKF and VOLUME), from the last value written if there is one. The
+   * SM_RESET and SM_CANCEL mode bits are never cached.
+   * @param addr Register address to read from
+   * @return Returns the register contents
+   */
+  uint16_t sciReadCached(uint8_t addr);
+  /*!
+   * @brief Writes several words to the same register in one SCI transaction,
+   * waiting for DREQ between words as the datasheet asks. Mostly useful with
+   * VS1053_REG_WRAM, which moves on to the next address after each word.
+   * @param addr Register address to write to
+   * @param data Words to write
+   * @param n Number of words
+   */
+  void sciWriteMulti(uint8_t addr, const uint16_t *data, uint16_t n);
+  /*!
+   * @brief Queue a register write to send later with sciFlush(), for
+   * example from a moment when the decoder FIFO is full anyway. The queue
+   * is flushed first if it already holds VS1053_SCIQUEUELEN writes.
+   * @param addr Register address to write to
+   * @param data Data to write
+   */
+  void sciQueue(uint8_t addr, uint16_t data);
+  /*!
+   * @brief Send all queued register writes, in order. Writes to the same
+   * register one after another share a single SCI transaction.
+   */
+  void sciFlush(void);
+  /*!
+   * @brief Reads a word of VS1053 memory (X, Y or I space, see the
+   * datasheet memory map)
+   * @param addr Address to read from
+   * @return Returns the word read
+   */
+  uint16_t wramRead(uint16_t addr);
+  /*!
+   * @brief Writes a word of VS1053 memory
+   * @param addr Address to write to
+   * @param data Word to write
+   */
+  void wramWrite(uint16_t addr, uint16_t data);
+  /*!
+   * @brief Reads a word of memory the chip only changes when told to (the
+   * GPIO direction and output registers), from the last value written if
+   * there is one
+   * @param addr Address to read from
+   * @return Returns the word
+   */
+  uint16_t wramReadCached(uint16_t addr);
+  /*!
+   * @brief Reads consecutive words of VS1053 memory, setting the address
+   * only once
+   * @param addr First address to read from
+   * @param data Buffer for the words read
+   * @param n Number of words
+   */
+  void wramReadBlock(uint16_t addr, uint16_t *data, uint16_t n);
+  /*!
+   * @brief Writes consecutive words of VS1053 memory in one SCI transaction
+   * @param addr First address to write to
+   * @param data Words to write
+   * @param n Number of words
+   */
+  void wramWriteBlock(uint16_t addr, const uint16_t *data, uint16_t n);
+  /*!
+   * @brief SPI clock used for SCI (control) transfers. It follows the clock
+   * multiplier in CLOCKF: SCI reads may run at CLKI/7, up to
+   * VS1053_SPI_MAXCLOCK, and it drops back to VS1053_SCI_RESETCLOCK over
+   * resets.
+   * @return Returns the clock asked of the SPI driver in Hz, the hardware may
+   * round it down
+   */
+  uint32_t sciClock(void);
+  /*!
+   * @brief SPI clock used for SDI (data) transfers, CLKI/4 up to
+   * VS1053_SPI_MAXCLOCK
+   * @return Returns the clock asked of the SPI driver in Hz, the hardware may
+   * round it down
+   */
+  uint32_t sdiClock(void);
   /*!
    * @brief Generate a sine-wave test signal
    * @param n Defines the sine test to use
@@ -193,19 +400,85 @@ public:
    * @param buffsiz Size to decode and play
    */
   void playData(uint8_t *buffer, uint8_t buffsiz);
+  /*!
+   * @brief Send as much of the supplied buffer as the decoder will take in a
+   * single SPI transaction, checking DREQ after every VS1053_DATABUFFERLEN
+   * bytes and keeping DCS asserted in between.
+   * @param buffer Buffer to decode and play. The contents are overwritten
+   * with whatever is clocked back in over MISO.
+   * @param buffsiz Size to decode and play
+   * @return Returns the number of bytes sent, 0 if DREQ was low
+   */
+  size_t playDataBurst(uint8_t *buffer, size_t buffsiz);
+  /*!
+   * @brief Start a stream of raw 16-bit PCM, e.g. synthesized on the fly.
+   * A WAV header with the lengths left open is sent so the decoder knows
+   * what's coming, then the samples go in with playPCM(). Not for use while
+   * a file player is feeding the chip.
+   * @param rate Sample rate in Hz
+   * @param channels 1 for mono, 2 for stereo
+   */
+  void startPCM(uint16_t rate, uint8_t channels);
+  /*!
+   * @brief Send samples of a stream started with startPCM(). Whenever DREQ
+   * is high they go out in one SPI transaction, checking DREQ after every
+   * VS1053_DATABUFFERLEN bytes.
+   * @param samples Signed samples, interleaved left then right for stereo
+   * @param count Number of samples (not frames)
+   * @param block true to wait on DREQ until all are sent, false to only send
+   * what the decoder will take right now
+   * @return Returns the number of samples sent
+   */
+  size_t playPCM(const int16_t *samples, size_t count, boolean block = true);
+  /*!
+   * @brief End a PCM stream, flushing the last samples through the decoder
+   */
+  void endPCM(void);
+  /*!
+   * @brief Estimate how far behind the samples sent with playPCM() the
+   * output is, i.e. how much audio is queued in the chip. It's worked out
+   * from the samples sent and the time since the stream started (or last
+   * ran dry), so it's only meaningful while the stream keeps up. With the
+   * FIFO kept full this is the lowest latency possible at the sample rate.
+   * @return Returns the latency in microseconds, 0 if the chip has run dry
+   */
+  uint32_t pcmLatency(void);
+  /*!
+   * @brief Reads the byteRate parameter, the decoder's estimate of the
+   * average data rate of the current stream
+   * @return Returns the byte rate in bytes per second, 0 if not known yet
+   */
+  uint16_t byteRate(void);
+  /*!
+   * @brief Reads the endFillByte parameter, which must be sent after the end
+   * of a stream to flush it through the decoder
+   * @return Returns the fill byte
+   */
+  uint8_t endFillByte(void);
+  /*!
+   * @brief Use an asynchronous (e.g. DMA) transport for SDI data. SCI
+   * access and playData() wait for any transfer in flight before using the
+   * SPI bus themselves.
+   * @param transport Transport to use, or NULL to go back to CPU writes
+   */
+  void useTransport(Adafruit_VS1053_SDITransport *transport);
   /*!
    * @brief Test if ready for more data
    * @return Returns true if it is ready for data
    */
   boolean readyForData(void);
   /*!
-   * @brief Apply a code patch
+   * @brief Apply a code patch in the VLSI compressed plugin format (.plg),
+   * held in PROGMEM. Each run of words goes out in one SCI transaction. The
+   * extras/plugin2progmem.py tool turns .img and .plg files into these
+   * tables.
    * @param patch Patch to apply
-   * @param patchsize Patch size
+   * @param patchsize Patch size, in words
    */
   void applyPatch(const uint16_t *patch, uint16_t patchsize);
   /*!
-   * @brief Load the specified plug-in
+   * @brief Load the specified plug-in from an .img file on the SD card,
+   * VS1053_PLUGINBUFLEN words at a time
    * @param fn Plug-in to load
    * @return Either returns 0xFFFF if there is an error, or the address of the
    * plugin that was loaded
@@ -256,6 +529,31 @@ public:
    * @brief Stop the recording
    */
   void stopRecordOgg(void);
+  /*!
+   * @brief Start recording 16-bit linear PCM with the chip's own encoder,
+   * no plugin needed. Read the data like an Ogg recording, the words are
+   * big endian so they need swapping for a WAV file.
+   * @param rate Sample rate in Hz, 8000 to 48000
+   * @param channels 1 for the left channel only (where the mic is), 2 for
+   * stereo
+   * @param mic mic=true for microphone input
+   */
+  void startRecordPCM(uint16_t rate, uint8_t channels, boolean mic);
+  /*!
+   * @brief Start recording IMA ADPCM with the chip's own encoder, no plugin
+   * needed. The data comes in blocks of VS1053_ADPCMBLOCKLEN bytes per
+   * channel, ready for a WAV file as it is.
+   * @param rate Sample rate in Hz, 8000 to 48000
+   * @param channels 1 for the left channel only (where the mic is), 2 for
+   * stereo
+   * @param mic mic=true for microphone input
+   */
+  void startRecordADPCM(uint16_t rate, uint8_t channels, boolean mic);
+  /*!
+   * @brief Stop a PCM or ADPCM recording. The encoder can only be left with
+   * a soft reset, so anything still waiting is lost.
+   */
+  void stopRecordPCM(void);
   /*!
    * @brief Returns the number of words recorded
    * @return 2-byte unsigned int with the number of words
@@ -266,10 +564,40 @@ public:
    * @return Returns the 16-bit data corresponding to the received address
    */
   uint16_t recordedReadWord(void);
+  /*!
+   * @brief Reads a block of recorded words, high byte of each word first
+   * (the order they go in the file). Interrupts are held off once for the
+   * whole block rather than per word.
+   * @param buffer Where to put the data, two bytes per word
+   * @param words Number of words to read, at most recordedWordsWaiting()
+   */
+  void recordedRead(uint8_t *buffer, uint16_t words);
 
   uint8_t mp3buffer[VS1053_DATABUFFERLEN]; //!< mp3 buffer that gets sent to the
                                            //!< device
 
+protected:
+  Adafruit_VS1053_SDITransport *sdiTransport = NULL; //!< Async SDI, if any
+  /*!
+   * @brief Wait for any async SDI transfer to finish
+   */
+  void waitForTransport(void);
+  /*!
+   * @brief Turn interrupts off (if used) with no async SDI transfer in
+   * flight, so nothing else gets on the bus until interrupts()
+   */
+  void holdBus(void);
+  /*!
+   * @brief First half of softReset(), for callers that can't wait. Call
+   * finishSoftReset() once VS1053_SOFTRESETMS have passed
+   */
+  void startSoftReset(void);
+  /*!
+   * @brief Second half of softReset(), sets the SPI clocks to suit the
+   * clock multiplier the chip came back with
+   */
+  void finishSoftReset(void);
+
 #ifdef ARDUINO_ARCH_SAMD
 protected:
   uint32_t _dreq;                  //!< Data request pin
@@ -291,8 +619,298 @@ private:
   int8_t _mosi, _miso, _clk, _reset, _cs, _dcs;
   boolean useHardwareSPI;
 #endif
+
+private:
+  void sciTransfer(uint8_t addr, const uint16_t *data, uint16_t n,
+                   uint8_t flags = 0);
+  void sciWriteRun(uint8_t addr, const uint16_t *data, uint16_t n,
+                   uint8_t flags = 0);
+  // sciTransfer() flags
+  static const uint8_t SCI_PROGMEM = 0x01; // data is in PROGMEM
+  static const uint8_t SCI_REPEAT = 0x02;  // send data[0] n times
+  void sciWritten(uint8_t addr, uint16_t data);
+  Adafruit_SPIDevice *newSPIDevice(int8_t cs, uint32_t clock);
+  void setSPIClocks(uint32_t sciHz, uint32_t sdiHz);
+  void clockChanged(uint16_t clockf);
+  void startRecordADC(uint16_t rate, uint8_t channels, boolean mic,
+                      boolean pcm);
+  int32_t pcmQueued(uint32_t now);
+
+  uint32_t _sciClock = 0; // see sciClock()
+  uint32_t _sdiClock = 0; // see sdiClock()
+
+  // last values written to registers the chip doesn't change by itself,
+  // see sciReadCached() and wramReadCached()
+  uint16_t _shadow[VS1053_SHADOWLEN];
+  uint8_t _shadowValid = 0; // bit per _shadow entry
+  // see sciQueue()
+  uint8_t _sciQueueAddr[VS1053_SCIQUEUELEN];
+  uint16_t _sciQueueData[VS1053_SCIQUEUELEN];
+  uint8_t _sciQueued = 0;
+  // see startPCM()
+  uint16_t _pcmRate = 0; // 0 when no stream is running
+  uint8_t _pcmChannels = 1;
+  uint32_t _pcmSamples = 0; // sent since _pcmStart
+  uint32_t _pcmStart = 0;
+};
+
+/*!
+ * @brief Source of audio data for Adafruit_VS1053_FilePlayer. Subclass this
+ * to play from somewhere other than the built-in sources.
+ */
+class Adafruit_VS1053_Source {
+public:
+  virtual ~Adafruit_VS1053_Source() {}
+  /*!
+   * @brief Read audio data
+   * @param buffer Buffer to read into
+   * @param len Maximum number of bytes to read
+   * @return Returns the number of bytes read, 0 if nothing is available right
+   * now (but more may come later) or -1 at the end of the stream
+   */
+  virtual int read(uint8_t *buffer, size_t len) = 0;
+  /*!
+   * @brief Number of bytes that can be read right now without waiting
+   * @return Returns the number of bytes available
+   */
+  virtual uint32_t available(void) = 0;
+  /*!
+   * @brief Move to a byte position in the stream
+   * @param pos Position to move to
+   * @return Returns true on success, false if the source can't seek
+   */
+  virtual boolean seek(uint32_t pos) {
+    (void)pos;
+    return false;
+  }
+  /*!
+   * @brief Current byte position in the stream
+   * @return Returns the position, or 0 if unknown
+   */
+  virtual uint32_t position(void) { return 0; }
+  /*!
+   * @brief Total length of the stream
+   * @return Returns the size in bytes, or 0 if unknown
+   */
+  virtual uint32_t size(void) { return 0; }
+  /*!
+   * @brief Called by the player when it is done with the source
+   */
+  virtual void close(void) {}
+};
+
+/*!
+ * @brief Plays from a file, e.g. one opened with SD.open()
+ */
+class Adafruit_VS1053_FileSource : public Adafruit_VS1053_Source {
+public:
+  /*!
+   * @brief Constructor
+   * @param file File to read from, must stay in scope while playing
+   */
+  Adafruit_VS1053_FileSource(File &file) : _file(file) {}
+  int read(uint8_t *buffer, size_t len);
+  uint32_t available(void);
+  boolean seek(uint32_t pos);
+  uint32_t position(void);
+  uint32_t size(void);
+  void close(void);
+
+private:
+  File &_file;
+};
+
+/*!
+ * @brief Plays from a buffer in RAM or PROGMEM
+ */
+class Adafruit_VS1053_MemorySource : public Adafruit_VS1053_Source {
+public:
+  /*!
+   * @brief Constructor
+   * @param data Audio data
+   * @param len Length of the data in bytes
+   * @param progmem true if data is in PROGMEM
+   */
+  Adafruit_VS1053_MemorySource(const uint8_t *data, uint32_t len,
+                               boolean progmem = false)
+      : _data(data), _len(len), _pos(0), _progmem(progmem) {}
+  int read(uint8_t *buffer, size_t len);
+  uint32_t available(void);
+  boolean seek(uint32_t pos);
+  uint32_t position(void);
+  uint32_t size(void);
+
+private:
+  const uint8_t *_data;
+  uint32_t _len;
+  uint32_t _pos;
+  boolean _progmem;
+};
+
+/*!
+ * @brief Plays from an Arduino Stream such as a Serial port or network
+ * client. Only what has already arrived is read, so use deferReads() and
+ * call fillBuffer() from loop() rather than reading it in the interrupt.
+ */
+class Adafruit_VS1053_StreamSource : public Adafruit_VS1053_Source {
+public:
+  /*!
+   * @brief Constructor
+   * @param stream Stream to read from
+   */
+  Adafruit_VS1053_StreamSource(Stream &stream) : _stream(stream) {}
+  int read(uint8_t *buffer, size_t len);
+  uint32_t available(void);
+
+private:
+  Stream &_stream;
+};
+
+/*!
+ * @brief Push-mode source, the sketch write()s data in whenever it arrives
+ * and the player takes it out as the decoder needs it. Data arriving in
+ * bursts (e.g. from a network) is smoothed by the buffer. One writer and one
+ * reader may use it at the same time without locking.
+ */
+class Adafruit_VS1053_PushSource : public Adafruit_VS1053_Source {
+public:
+  /*!
+   * @brief Constructor
+   * @param buffer Buffer to hold data waiting to be played
+   * @param len Length of the buffer in bytes
+   */
+  Adafruit_VS1053_PushSource(uint8_t *buffer, uint32_t len)
+      : _buffer(buffer), _len(len), _head(0), _tail(0), _ended(false) {}
+  /*!
+   * @brief Add data to the stream
+   * @param data Data to add
+   * @param len Length of the data in bytes
+   * @return Returns the number of bytes accepted, may be less than len if
+   * the buffer is full
+   */
+  size_t write(const uint8_t *data, size_t len);
+  /*!
+   * @brief Space left in the buffer
+   * @return Returns the number of bytes that can be written
+   */
+  uint32_t availableForWrite(void);
+  /*!
+   * @brief Mark the end of the stream, the player stops once the buffer has
+   * been played out
+   */
+  void end(void) { _ended = true; }
+  /*!
+   * @brief Empty the buffer and clear the end of stream mark
+   */
+  void clear(void);
+  int read(uint8_t *buffer, size_t len);
+  uint32_t available(void);
+
+private:
+  uint8_t *_buffer;
+  uint32_t _len;
+  // indexes into _buffer, wrapped back to 0 on reaching _len. One byte is
+  // left free so that head == tail only when it's empty
+  volatile uint32_t _head;
+  volatile uint32_t _tail;
+  volatile boolean _ended;
 };
 
+/*!
+ * @brief Playback counters kept by Adafruit_VS1053_FilePlayer, see
+ * getFeedStats()
+ */
+typedef struct {
+  uint32_t feeds;          //!< Feeds that found the decoder wanting data
+  uint32_t bytesFed;       //!< Bytes sent to the decoder
+  uint32_t lockCollisions; //!< feedBuffer() calls made while already feeding
+  uint32_t underruns; //!< Feeds where DREQ was high but no data was buffered
+  uint32_t maxFeedInterval; //!< Longest time between feeds, in microseconds
+  uint32_t maxReadTime;     //!< Longest single source read, in microseconds
+  uint32_t mixTime;         //!< Time spent mixing in prompts, in microseconds
+  uint32_t readTime;        //!< Time spent in source reads, in microseconds
+  uint32_t sdiTime;         //!< Time spent on SDI writes, in microseconds
+  uint32_t pollTime;        //!< Time spent polling DREQ, in microseconds
+  uint32_t sdiTransfers;    //!< SDI transactions used to send bytesFed
+  uint32_t sciClock;        //!< SPI clock for SCI transfers, in Hz
+  uint32_t sdiClock;        //!< SPI clock for SDI transfers, in Hz
+} vs1053_feedstats_t;
+
+/*!
+ * @brief Audio formats told apart by
+ * Adafruit_VS1053_FilePlayer::detectFormat()
+ */
+typedef enum {
+  VS1053_FORMAT_UNKNOWN, //!< Not recognised, left to the decoder
+  VS1053_FORMAT_MP3,     //!< MPEG audio, layer I, II or III
+  VS1053_FORMAT_AAC,     //!< AAC in ADTS frames
+  VS1053_FORMAT_MP4,     //!< MP4/M4A container
+  VS1053_FORMAT_OGG,     //!< Ogg Vorbis
+  VS1053_FORMAT_FLAC,    //!< FLAC, needs the VLSI FLAC patch loaded
+  VS1053_FORMAT_WAV,     //!< RIFF WAVE
+  VS1053_FORMAT_MIDI,    //!< Standard MIDI file
+} vs1053_format_t;
+
+/*!
+ * @brief Track details filled in by
+ * Adafruit_VS1053_FilePlayer::readMetadata(). Strings are truncated to fit
+ * and are empty when the track doesn't have them, numbers are 0 if unknown.
+ */
+typedef struct {
+  char title[VS1053_TAGLEN];  //!< Track title
+  char artist[VS1053_TAGLEN]; //!< Artist
+  char album[VS1053_TAGLEN];  //!< Album
+  uint32_t audioStart;        //!< Byte position where the audio data starts
+  uint32_t audioEnd;          //!< Byte position just after the audio data
+  uint32_t durationMs;        //!< Length of the track in milliseconds
+  uint32_t sampleRate;        //!< Sample rate in Hz
+  uint16_t bitrate;           //!< Average bitrate in kbit/s
+  uint8_t channels;           //!< 1 for mono, 2 for stereo
+  uint8_t bitsPerSample;      //!< For linear PCM WAVs, 0 for anything else
+  uint16_t blockAlign;        //!< WAV block size, a frame for linear PCM
+  vs1053_format_t format;     //!< Format, from the data itself
+} vs1053_metadata_t;
+
+/*!
+ * @brief Recording counters kept by Adafruit_VS1053_FilePlayer, see
+ * getRecordStats()
+ */
+typedef struct {
+  uint32_t bytesWritten; //!< Bytes written to the file
+  uint32_t overruns; //!< Polls that found more than VS1053_RECOVERFLOW words
+                     //!< waiting, when the chip may have dropped some
+  uint32_t ringFull; //!< Polls that left words in the chip because the RAM
+                     //!< ring was full, i.e. the card is falling behind
+  uint32_t polls;    //!< Times the chip's record buffer was read
+  uint32_t maxWriteTime; //!< Longest single SD write, in microseconds
+  uint16_t maxWaiting;   //!< Most words ever found waiting in the chip
+  uint16_t maxBuffered;  //!< Most bytes ever held in the RAM ring
+} vs1053_recordstats_t;
+
+/*!
+ * @brief States of the non-blocking player, see
+ * Adafruit_VS1053_FilePlayer::tick()
+ */
+typedef enum {
+  VS1053_STATE_STOPPED,    //!< Nothing playing
+  VS1053_STATE_OPENING,    //!< Stopping the last track, opening the new one
+  VS1053_STATE_PREFILLING, //!< Filling the decoder FIFO before playback
+  VS1053_STATE_PLAYING,    //!< Playing (or paused)
+  VS1053_STATE_DRAINING,   //!< Flushing, cancelling or resetting the decoder
+} vs1053_playstate_t;
+
+/*!
+ * @brief Shapes of volume fade, see Adafruit_VS1053_FilePlayer::fadeTo().
+ * The volume register is already in half dB steps, so a linear fade
+ * sounds even.
+ */
+typedef enum {
+  VS1053_FADE_LINEAR,  //!< Same change every step
+  VS1053_FADE_EASEIN,  //!< Starts slowly, ends quickly
+  VS1053_FADE_EASEOUT, //!< Starts quickly, ends slowly
+  VS1053_FADE_SMOOTH,  //!< Starts and ends slowly
+} vs1053_fadecurve_t;
+
 /*!
  * @brief File player for the Adafruit VS1053
  */
@@ -342,7 +960,9 @@ public:
   /*!
    * @brief Specifies the argument to use for interrupt-driven playback
    * @param type interrupt to use. Valid arguments are
-   * VS1053_FILEPLAYER_TIMER0_INT and VS1053_FILEPLAYER_PIN_INT
+   * VS1053_FILEPLAYER_TIMER0_INT and VS1053_FILEPLAYER_PIN_INT. Up to
+   * VS1053_MAX_PLAYERS players can be registered, each interrupt feeds them
+   * all.
    * @return Returs true/false for success/failure
    */
   boolean useInterrupt(uint8_t type);
@@ -365,6 +985,36 @@ public:
    * @return returns the seek position within the file where the mp3 data starts
    */
   unsigned long mp3_ID3Jumper(File mp3);
+  /*!
+   * @brief Read the title, artist, album, length and bitrate of a track in a
+   * single pass over its headers. Understands ID3v2.2-2.4, ID3v1 and APEv2
+   * tags on MP3s, FLAC and Ogg Vorbis headers with their Vorbis comments,
+   * and WAV headers. Nothing is allocated, only the fields asked for are
+   * copied out of the file.
+   * @param source Source to read, must be able to seek. Use a separate
+   * Adafruit_VS1053_FileSource rather than the one that's playing.
+   * @param meta Filled in with what was found
+   * @return Returns false if the source couldn't be read at all
+   */
+  static boolean readMetadata(Adafruit_VS1053_Source *source,
+                              vs1053_metadata_t *meta);
+  /*!
+   * @brief Work out the format of a track from its first bytes, looking
+   * past any ID3v2 tag, whatever the file is called. The read position is
+   * left where it was.
+   * @param source Source to check, must be able to seek. Sources that
+   * can't are reported as VS1053_FORMAT_UNKNOWN without reading anything.
+   * @param start Set to where the audio starts, after any ID3v2 tag
+   * @return Returns the format found
+   */
+  static vs1053_format_t detectFormat(Adafruit_VS1053_Source *source,
+                                      uint32_t *start);
+  /*!
+   * @brief Format of the track that's playing, as found by detectFormat()
+   * when it was started
+   * @return Returns the format
+   */
+  vs1053_format_t trackFormat(void);
   /*!
    * @brief Begin playing the specified file from the SD card using
    * interrupt-drive playback.
@@ -372,6 +1022,57 @@ public:
    * @return Returns true when file starts playing
    */
   boolean startPlayingFile(const char *trackname);
+  /*!
+   * @brief Begin playing from any source using interrupt-driven playback
+   * @param source Source to play, must stay in scope while playing
+   * @param start Byte position in the source where the audio starts. With
+   * 0, seekable sources have any ID3v2 tag skipped, see detectFormat()
+   * @return Returns true when the source starts playing
+   */
+  boolean startPlayingSource(Adafruit_VS1053_Source *source,
+                             uint32_t start = 0);
+  /*!
+   * @brief Begin playing the specified file from the SD card without
+   * blocking. The work is done by tick(), which must be called from loop().
+   * A track that's still playing is cancelled by the feeder first.
+   * @param *trackname File to play, must stay valid until it has been opened
+   * @return Returns true if the track was queued
+   */
+  boolean startPlayingFileAsync(const char *trackname);
+  /*!
+   * @brief Queue a file to play straight after the current one. tick()
+   * opens it and skips any ID3 tag while the current track is still
+   * playing. An MP3 following an MP3 carries on in the same stream without
+   * a gap, anything else starts once the current track has been finished
+   * and the decoder cancelled. Queue the following track from the
+   * onTrackStarted() callback to play an album.
+   * @param *trackname File to play, must stay valid until it has been opened
+   * @return Returns false if a track is already queued
+   */
+  boolean queueFile(const char *trackname);
+  /*!
+   * @brief Advance the non-blocking player. Call this often from loop(), it
+   * never waits on the decoder. Also feeds the decoder when not using
+   * interrupts, and calls fillBuffer() when reads are deferred.
+   */
+  void tick(void);
+  /*!
+   * @brief Current state of the non-blocking player
+   * @return Returns the player state
+   */
+  vs1053_playstate_t playState(void);
+  /*!
+   * @brief Set a function to call from tick() when a track starts playing,
+   * including queued tracks
+   * @param callback Function to call, or NULL for none
+   */
+  void onTrackStarted(void (*callback)(Adafruit_VS1053_FilePlayer *player));
+  /*!
+   * @brief Set a function to call from tick() when a track has finished
+   * (or could not be opened)
+   * @param callback Function to call, or NULL for none
+   */
+  void onTrackEnded(void (*callback)(Adafruit_VS1053_FilePlayer *player));
   /*!
    * @brief Play the complete file. This function will not return until the
    * playback is complete
@@ -379,7 +1080,11 @@ public:
    * @return Returns true when file starts playing
    */
   boolean playFullFile(const char *trackname);
-  void stopPlaying(void); //!< Stop playback
+  /*!
+   * @brief Stop playback. Uses the datasheet's SM_CANCEL sequence so the
+   * decoder is ready for the next track without a reset.
+   */
+  void stopPlaying(void);
   /*!
    * @brief If playback is paused
    * @return Returns true if playback is paused
@@ -407,6 +1112,170 @@ public:
    * @return Returns true when looped playback is enabled
    */
   boolean playbackLooped();
+  /*!
+   * @brief Set state for burst feeding, where each feed sends as many
+   * VS1053_DATABUFFERLEN chunks as DREQ allows in one SPI transaction
+   * @param burstState Sets burst feed state
+   */
+  void burstFeed(boolean burstState);
+  /*!
+   * @brief Retrieve burst feed state
+   * @return Returns true when burst feeding is enabled
+   */
+  boolean burstFeeding();
+  /*!
+   * @brief Set state for deferred reads. When enabled, feedBuffer() (and so
+   * the DREQ/timer interrupt) only sends data that is already buffered, and
+   * all SD card reads happen in fillBuffer(), which the sketch must then
+   * call regularly from loop() or a task.
+   * @param deferState Sets deferred read state
+   */
+  void deferReads(boolean deferState);
+  /*!
+   * @brief Retrieve deferred read state
+   * @return Returns true when reads are deferred to fillBuffer()
+   */
+  boolean readsDeferred();
+  /*!
+   * @brief Mix a prompt (a beep, a voice clip) into the track that's
+   * playing, turning the track down while it plays, see setDucking(). The
+   * mixing is done on the data on its way to the decoder, so only 16-bit
+   * PCM WAV tracks can have prompts mixed in. A prompt already playing is
+   * replaced, and one still playing when the track ends is cut off.
+   * @param clip Mono samples at the track's sample rate, played on every
+   * channel. Must stay in scope until prompting() goes false.
+   * @param samples Number of samples in the clip
+   * @param progmem true if the clip is in PROGMEM
+   * @return Returns false if the track can't be mixed
+   */
+  boolean playPrompt(const int16_t *clip, uint32_t samples,
+                     boolean progmem = false);
+  /*!
+   * @brief Check if a prompt is still being mixed in
+   * @return Returns true while it plays
+   */
+  boolean prompting(void);
+  /*!
+   * @brief Set how the track is turned down (ducked) while a prompt plays.
+   * It fades down as the prompt starts and back up once it ends.
+   * @param level Track level during prompts out of 256, 256 leaves it alone
+   * @param rampMs Time taken to fade down or up, in milliseconds
+   */
+  void setDucking(uint16_t level, uint16_t rampMs);
+  /*!
+   * @brief Fade the volume to a new setting without blocking. While a
+   * track plays the steps are written from the feed, between bursts of data
+   * while the decoder's FIFO is well filled. When it's paused or stopped
+   * tick() does them instead. Either way there's at most one step every
+   * VS1053_FADEINTERVAL ms, and only when the setting changes.
+   * @param left Left channel volume, as for setVolume()
+   * @param right Right channel volume, as for setVolume()
+   * @param durationMs How long the fade takes, 0 to set it right away. That
+   * also stops a fade that's going, which would otherwise undo setVolume()
+   * @param curve Shape of the fade
+   */
+  void fadeTo(uint8_t left, uint8_t right, uint16_t durationMs,
+              vs1053_fadecurve_t curve = VS1053_FADE_LINEAR);
+  /*!
+   * @brief Check if a fade is still going
+   * @return Returns true until the final volume has been written
+   */
+  boolean fading(void);
+  /*!
+   * @brief Tops up the read-ahead buffer from the current track, then feeds
+   * the decoder if it's waiting. Only needed when reads are deferred, see
+   * deferReads()
+   */
+  void fillBuffer(void);
+  /*!
+   * @brief Jump to a byte position in the current track. Whatever is still
+   * in the read-ahead buffer is dropped, the decoder resyncs on its own.
+   * @param pos Position from the start of the file (or source)
+   * @return Returns true on success
+   */
+  boolean seekToByte(uint32_t pos);
+  /*!
+   * @brief Jump to a time in the current track. Uses the Xing or VBRI
+   * header of VBR MP3s when there is one, otherwise the decoder's byteRate,
+   * which is only known once playback has started. WAV positions are
+   * rounded down to the start of a block.
+   * @param ms Time from the start of the track in milliseconds
+   * @return Returns true on success
+   */
+  boolean seekToMillis(uint32_t ms);
+  /*!
+   * @brief Set state for seek indexing. When enabled, each track opened
+   * from the SD card gets a sidecar file with the same name and a .idx
+   * extension, holding the file position every VS1053_SEEKINDEX_INTERVAL
+   * seconds. It is filled in by tick() the first time the track plays
+   * through and seekToMillis() uses it from then on.
+   * @param indexState Sets seek index state
+   */
+  void seekIndex(boolean indexState);
+  /*!
+   * @brief Retrieve seek index state
+   * @return Returns true when seek indexing is enabled
+   */
+  boolean seekIndexing();
+  /*!
+   * @brief Get a snapshot of the playback counters
+   * @param stats Where to copy the counters
+   */
+  void getFeedStats(vs1053_feedstats_t *stats);
+  /*!
+   * @brief Zero the playback counters
+   */
+  void resetFeedStats(void);
+  /*!
+   * @brief Record to a file on the SD card, using the Ogg Vorbis encoder
+   * loaded with prepareRecordOgg(). The chip's buffer is polled into the
+   * file read-ahead buffer, used as a RAM ring, and tick() writes it to the
+   * card a sector at a time. With useInterrupt() the polling is done from
+   * the interrupt, so a slow card write or a busy loop() doesn't lose data
+   * as long as the ring has room. A poll that comes due while the card is
+   * being written is done as soon as the write is out. Polls are spaced
+   * out to suit the encoder's bitrate, see VS1053_RECPOLLMIN. Stops any
+   * playback. On AVR the ring is only 64 bytes, so the card is written 32
+   * bytes at a time rather than in whole sectors, and a slow write can let
+   * the chip's buffer overrun at high bitrates (see ringFull and overruns
+   * in getRecordStats()).
+   * @param filename File to record to, replaced if it exists
+   * @param mic true for the microphone input, false for line in
+   * @return Returns false if the file couldn't be opened
+   */
+  boolean startRecordingOgg(const char *filename, boolean mic);
+  /*!
+   * @brief Record a WAV file with the chip's own PCM or IMA ADPCM encoder,
+   * which needs no plugin. Works like startRecordingOgg(); the header is
+   * written first and its sizes are filled in when the file is closed.
+   * @param filename File to record to, replaced if it exists
+   * @param rate Sample rate in Hz, 8000 to 48000
+   * @param channels 1 for the left channel only (where the mic is), 2 for
+   * stereo
+   * @param adpcm true for IMA ADPCM (4 bits a sample), false for 16-bit PCM
+   * @param mic true for the microphone input, false for line in
+   * @return Returns false if the file couldn't be opened
+   */
+  boolean startRecordingWAV(const char *filename, uint16_t rate,
+                            uint8_t channels, boolean adpcm, boolean mic);
+  /*!
+   * @brief Ask the encoder to finish. tick() writes out the rest of the
+   * data and closes the file, recording() goes false once it's done. A WAV
+   * recording keeps what's already waiting in the chip, then the encoder is
+   * reset.
+   */
+  void stopRecording(void);
+  /*!
+   * @brief Check if a recording is running or still being finished off
+   * @return Returns true until the file has been closed
+   */
+  boolean recording(void);
+  /*!
+   * @brief Get a snapshot of the recording counters, which are zeroed when
+   * a recording starts
+   * @param stats Where to copy the counters
+   */
+  void getRecordStats(vs1053_recordstats_t *stats);
   /*!
    * @brief Determine current playback speed
    * @return Returns playback speed, i.e. 1 for 1x, 2 for 2x, 3 for 3x
@@ -419,9 +1288,153 @@ public:
   void setPlaySpeed(uint16_t speed);
 
 private:
+  void init(int8_t cardcs);
+  boolean lockFeed(void);
+  void unlockFeed(void);
+  void lockCard(void);
   void feedBuffer_noLock(void);
+  void feedTransport(void);
+  boolean feedReady(void);
+  void mixFeed(uint16_t len);
+  void mixSkip(uint16_t len);
+  void fadeStep(void);
+  void nextMixFrame(void);
+  void fillFileBuffer(void);
+  void resetFileBuffer(void);
+  void endOfTrack(void);
+  void closeSource(void);
+  void cancelDecoding(void);
+  void startCancel(void);
+  uint8_t sendCancelData(void);
+  boolean openTrack(const char *trackname, uint32_t *start);
+  void prepareSource(Adafruit_VS1053_Source *source, uint32_t start);
+  boolean beginPlayback(Adafruit_VS1053_Source *source, uint32_t start);
+  void startPrefill(Adafruit_VS1053_Source *source, uint32_t start);
+  boolean seekSource(uint32_t pos);
+  uint32_t alignToBlock(uint32_t pos);
+  void readVBRHeader(void);
+  void seekIndexName(const char *trackname, char *indexname);
+  void openSeekIndex(const char *indexname);
+  boolean checkSeekIndex(void);
+  void closeSeekIndex(void);
+  void updateSeekIndex(void);
+  boolean lookupSeekIndex(uint32_t ms, uint32_t *pos);
+  boolean openRecording(const char *filename);
+  boolean writeWAVHeader(void);
+  void serviceRecording(void);
+  void pollRecording(void);
+  uint16_t readRecording(uint16_t waiting);
+  boolean writeRecording(uint16_t offset, uint16_t len);
+  boolean writeRecordedBlocks(void);
+  void finishRecording(void);
 
   uint8_t _cardCS;
+  Adafruit_VS1053_FileSource _fileSource; // wraps currentTrack
+  Adafruit_VS1053_Source *_source;        // what we're playing, NULL if none
+  uint32_t _sourceStart;                  // where looped playback restarts
+  vs1053_format_t _format;                // of the track that's playing
+
+  // from the VBR header of the current track, see readVBRHeader()
+  boolean _vbrChecked;
+  uint32_t _durationMs; // 0 if unknown
+  uint32_t _audioBytes; // 0 if unknown
+  uint32_t _tocPos;     // position of the Xing TOC, 0 if none
+
+  // WAV data can only be entered on a block boundary, see alignToBlock()
+  uint32_t _blockStart;
+  uint16_t _blockAlign; // 0 if any byte will do
+
+  boolean _seekIndex;
+  File _indexFile;         // seek index of the current track
+  boolean _indexRecording; // decodeTime() can be trusted to add entries
+  uint32_t _indexChecked;  // millis() when updateSeekIndex() last looked
+  uint16_t _indexLastTime; // decodeTime() it saw then, 0xFFFF at first
+  char _nextIndexName[VS1053_INDEXNAMELEN]; // for the queued track
+  vs1053_playstate_t _playState;
+  const char *_asyncTrack;         // track for tick() to open
+  volatile boolean _finishing;     // feeder is in endOfTrack()'s sequence
+  volatile boolean _cancelling;    // and it's a cancel, see startCancel()
+  uint16_t _drainLeft;             // fill bytes still to send while draining
+  uint16_t _cancelLeft;            // bytes to send waiting for SM_CANCEL
+  uint8_t _endFillByte;            // as read for the fill
+  boolean _resetPending;           // SM_CANCEL stuck, soft reset before next
+  boolean _resetting;              // tick() has a soft reset going
+  uint32_t _resetStart;            // millis() when it started
+  const char *_queuedTrack;        // track for tick() to open next
+  File _nextTrack;                 // opened by tick(), swapped in at the end
+  uint32_t _nextStart;             // where the audio starts in _nextTrack
+  vs1053_format_t _nextFormat;     // what's in _nextTrack
+  volatile boolean _nextOpen;      // _nextTrack is ready to be swapped in
+  volatile boolean _trackSwitched; // tell tick() we moved on to _nextTrack
+  void (*_trackStarted)(Adafruit_VS1053_FilePlayer *player);
+  void (*_trackEnded)(Adafruit_VS1053_FilePlayer *player);
+  boolean _loopPlayback;
+  boolean _burstFeed;
+  boolean _deferReads;
+  volatile boolean _feedBufferLock;
+  volatile boolean _feedPending; // feedBuffer() was called while locked
+
+  vs1053_feedstats_t _stats;
+  uint32_t _lastFeed; // micros() at the last feed, 0 if not playing
+
+  // Read-ahead ring between the SD card and the SDI bus. The head and tail
+  // are free running, the number of buffered bytes is (head - tail). Only
+  // the reader moves the head and only the feeder moves the tail. The card
+  // shares the bus with the decoder though, so with deferred reads
+  // fillBuffer() still takes the feed lock while it reads, and seeks do
+  // the same (see lockCard()). The interrupt never waits on the lock; a
+  // feed it misses is run when the lock is let go.
+  uint8_t _fileBuffer[VS1053_FILEBUFFERLEN];
+  volatile uint16_t _fileBufferHead;
+  volatile uint16_t _fileBufferTail;
+  volatile boolean _fileEOF; // reader hit the end of a non-looped track
+  uint16_t _transferLen;     // bytes handed to sdiTransport, not yet consumed
+
+  // prompt mixing, see playPrompt(). The mixer works on the buffer just
+  // ahead of the feeder, _mixHead being the first byte it hasn't seen
+  uint16_t _mixHead;
+  uint32_t _mixPos;   // position of _mixHead in the source
+  uint32_t _mixStart; // the track's 16-bit PCM data, 0 if it can't be mixed
+  uint32_t _mixEnd;
+  uint32_t _mixRate;
+  uint8_t _mixChannels;
+  // the reader looped or switched tracks at _mixRestartHead in the buffer,
+  // going back to _mixRestartPos in the source
+  boolean _mixRestart;
+  uint16_t _mixRestartHead;
+  uint32_t _mixRestartPos;
+  const int16_t *_prompt;
+  volatile uint32_t _promptLeft;
+  boolean _promptProgmem;
+  int16_t _promptSample; // for the frame being mixed
+  uint32_t _duckGain;    // of the track, 0x10000 is 1
+  uint32_t _duckLevel;   // what _duckGain fades to while prompting
+  uint32_t _duckStep;    // per frame
+  uint16_t _duckRampMs;
+
+  // volume fade, see fadeTo(). Volumes are VOLUME register values, left
+  // in the high byte
+  volatile boolean _fading;
+  uint16_t _fadeFrom;
+  uint16_t _fadeTarget;
+  uint16_t _fadeVolume; // last written
+  uint16_t _fadeDuration;
+  uint32_t _fadeStart;
+  uint32_t _fadeLast;
+  vs1053_fadecurve_t _fadeCurve;
+
+  // recording, see startRecordingOgg(). _fileBuffer is the ring, the
+  // poller moves the head and only tick() moves the tail
+  File _recordFile;
+  volatile uint8_t _recordState;
+  uint8_t _recordPad; // last word only has its high byte
+  uint32_t _recordLastPoll;
+  uint32_t _recordInterval;      // until the next poll, in microseconds
+  vs1053_format_t _recordFormat; // VS1053_FORMAT_OGG or VS1053_FORMAT_WAV
+  boolean _recordADPCM;
+  uint8_t _recordChannels;
+  uint16_t _recordRate;
+  vs1053_recordstats_t _recordStats;
 };
 
 #endif // ADAFRUIT_VS1053_H
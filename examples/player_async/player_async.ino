@@ -0,0 +1,96 @@
+/*************************************************** 
+  This is an example for the Adafruit VS1053 Codec Breakout
+
+  Designed specifically to work with the Adafruit VS1053 Codec Breakout 
+  ----> https://www.adafruit.com/products/1381
+
+  Adafruit invests time and resources providing this open source code, 
+  please support Adafruit and open-source hardware by purchasing 
+  products from Adafruit!
+
+  Written by Limor Fried/Ladyada for Adafruit Industries.  
+  BSD license, all text above must be included in any redistribution
+ ****************************************************/
+
+// Plays tracks one after the other without ever blocking loop(), so the
+// rest of the sketch (here, blinking the LED) keeps running smoothly
+
+// include SPI, MP3 and SD libraries
+#include <SPI.h>
+#include <Adafruit_VS1053.h>
+#include <SD.h>
+
+// These are the pins used for the breakout example
+#define BREAKOUT_RESET  9      // VS1053 reset pin (output)
+#define BREAKOUT_CS     10     // VS1053 chip select pin (output)
+#define BREAKOUT_DCS    8      // VS1053 Data/command select pin (output)
+// These are the pins used for the music maker shield
+#define SHIELD_RESET  -1      // VS1053 reset pin (unused!)
+#define SHIELD_CS     7      // VS1053 chip select pin (output)
+#define SHIELD_DCS    6      // VS1053 Data/command select pin (output)
+
+// These are common pins between breakout and shield
+#define CARDCS 4     // Card chip select pin
+// DREQ should be an Int pin, see http://arduino.cc/en/Reference/attachInterrupt
+#define DREQ 3       // VS1053 Data request, ideally an Interrupt pin
+
+Adafruit_VS1053_FilePlayer musicPlayer = 
+  // create breakout-example object!
+  Adafruit_VS1053_FilePlayer(BREAKOUT_RESET, BREAKOUT_CS, BREAKOUT_DCS, DREQ, CARDCS);
+  // create shield-example object!
+  //Adafruit_VS1053_FilePlayer(SHIELD_RESET, SHIELD_CS, SHIELD_DCS, DREQ, CARDCS);
+
+const char *tracks[] = { "/track001.mp3", "/track002.mp3" };
+uint8_t nextTrack = 0;
+
+void trackStarted(Adafruit_VS1053_FilePlayer *player) {
+  Serial.println(F("Track started"));
+  // fade in over a second, the steps are sent while the music is fed
+  player->fadeTo(20, 20, 1000, VS1053_FADE_EASEOUT);
+}
+
+void trackEnded(Adafruit_VS1053_FilePlayer *player) {
+  Serial.println(F("Track ended"));
+  // queue up the next one, tick() will open it
+  if (nextTrack < sizeof(tracks)/sizeof(tracks[0])) {
+    player->setVolume(254, 254);
+    player->startPlayingFileAsync(tracks[nextTrack++]);
+  }
+}
+
+void setup() {
+  Serial.begin(9600);
+  Serial.println("Adafruit VS1053 Non-blocking Test");
+
+  if (! musicPlayer.begin()) { // initialise the music player
+     Serial.println(F("Couldn't find VS1053, do you have the right pins defined?"));
+     while (1);
+  }
+  Serial.println(F("VS1053 found"));
+  
+  if (!SD.begin(CARDCS)) {
+    Serial.println(F("SD failed, or not present"));
+    while (1);  // don't do anything more
+  }
+
+  // Set volume for left, right channels. lower numbers == louder volume!
+  // Start silent, each track fades in when it starts
+  musicPlayer.setVolume(254,254);
+
+  // If DREQ is on an interrupt pin the data is fed in the background,
+  // otherwise tick() feeds it from loop()
+  musicPlayer.useInterrupt(VS1053_FILEPLAYER_PIN_INT);  // DREQ int
+
+  musicPlayer.onTrackStarted(trackStarted);
+  musicPlayer.onTrackEnded(trackEnded);
+  musicPlayer.startPlayingFileAsync(tracks[nextTrack++]);
+
+  pinMode(LED_BUILTIN, OUTPUT);
+}
+
+void loop() {
+  // never blocks, just moves the player along
+  musicPlayer.tick();
+
+  digitalWrite(LED_BUILTIN, (millis() / 250) & 1);
+}
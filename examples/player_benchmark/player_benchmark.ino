@@ -0,0 +1,158 @@
+/***************************************************
+  This is an example for the Adafruit VS1053 Codec Breakout
+
+  Designed specifically to work with the Adafruit VS1053 Codec Breakout
+  ----> https://www.adafruit.com/products/1381
+
+  Adafruit invests time and resources providing this open source code,
+  please support Adafruit and open-source hardware by purchasing
+  products from Adafruit!
+
+  Written by Limor Fried/Ladyada for Adafruit Industries.
+  BSD license, all text above must be included in any redistribution
+ ****************************************************/
+
+// Feed path benchmark. Plays each test file for a few seconds through the
+// library's own feedBuffer(), timing each call. The player's feed stats
+// split that time into reading the SD card, writing SDI data and polling
+// DREQ. One CSV line is printed per run so results can be logged and
+// compared between library versions.
+//
+// Copy test files of different bitrates/formats to the SD card with the
+// names listed in benchFiles[] below. FLAC needs the VLSI FLAC patch
+// loaded with applyPatch() first, so it's left commented out.
+
+// include SPI, MP3 and SD libraries
+#include <SPI.h>
+#include <Adafruit_VS1053.h>
+#include <SD.h>
+
+// These are the pins used for the breakout example
+#define BREAKOUT_RESET  9      // VS1053 reset pin (output)
+#define BREAKOUT_CS     10     // VS1053 chip select pin (output)
+#define BREAKOUT_DCS    8      // VS1053 Data/command select pin (output)
+// These are the pins used for the music maker shield
+#define SHIELD_RESET  -1      // VS1053 reset pin (unused!)
+#define SHIELD_CS     7      // VS1053 chip select pin (output)
+#define SHIELD_DCS    6      // VS1053 Data/command select pin (output)
+
+// These are common pins between breakout and shield
+#define CARDCS 4     // Card chip select pin
+#define DREQ 3       // VS1053 Data request pin
+
+#define BENCH_SECONDS 10  // how long to play each file/read size combination
+
+Adafruit_VS1053_FilePlayer musicPlayer =
+  // create breakout-example object!
+  Adafruit_VS1053_FilePlayer(BREAKOUT_RESET, BREAKOUT_CS, BREAKOUT_DCS, DREQ, CARDCS);
+  // create shield-example object!
+  //Adafruit_VS1053_FilePlayer(SHIELD_RESET, SHIELD_CS, SHIELD_DCS, DREQ, CARDCS);
+
+const char *benchFiles[] = {
+  "/bench064.mp3",
+  "/bench128.mp3",
+  "/bench192.mp3",
+  "/bench320.mp3",
+  "/bench.wav",
+  //"/bench.flc",
+};
+
+// Each file is played once sending 32 bytes per DREQ check, and once in
+// bursts, see burstFeed()
+const boolean burstModes[] = { false, true };
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Adafruit VS1053 Feed Benchmark");
+
+  if (! musicPlayer.begin()) { // initialise the music player
+     Serial.println(F("Couldn't find VS1053, do you have the right pins defined?"));
+     while (1);
+  }
+  Serial.println(F("VS1053 found"));
+
+  if (!SD.begin(CARDCS)) {
+    Serial.println(F("SD failed, or not present"));
+    while (1);  // don't do anything more
+  }
+
+  musicPlayer.setVolume(20,20);
+
+  // header line for the CSV results
+  Serial.println(F("file,burst,bytes,elapsed_ms,bytes_per_sec,feeds,"
+                   "underruns,max_read_us,max_feed_interval_us,"
+                   "cpu_us_per_audio_s,max_feed_us,read_us,sdi_us,poll_us,"
+                   "mix_us,sdi_transfers_per_kb,sdi_hz"));
+
+  for (uint8_t f=0; f<sizeof(benchFiles)/sizeof(benchFiles[0]); f++) {
+    for (uint8_t b=0; b<sizeof(burstModes)/sizeof(burstModes[0]); b++) {
+      benchFile(benchFiles[f], burstModes[b]);
+    }
+  }
+  Serial.println(F("Done"));
+}
+
+void loop() {
+  delay(100);
+}
+
+/// Play one file for BENCH_SECONDS, calling the library's feedBuffer()
+/// by hand so each call can be timed, then print the results as a CSV line
+void benchFile(const char *fn, boolean burst) {
+  musicPlayer.burstFeed(burst);
+  musicPlayer.resetFeedStats();
+  // no useInterrupt() here, so startPlayingFile() only prefills and every
+  // feed after that is one of ours
+  if (! musicPlayer.startPlayingFile(fn)) {
+    Serial.print(F("# could not open "));
+    Serial.println(fn);
+    return;
+  }
+
+  uint32_t feedTime = 0, maxFeed = 0;
+
+  uint32_t start = millis();
+  while (musicPlayer.playingMusic &&
+         (millis() - start) < (BENCH_SECONDS * 1000UL)) {
+    // idle polling isn't counted, an interrupt driven player wouldn't do it
+    if (!musicPlayer.readyForData())
+      continue;
+
+    uint32_t t0 = micros();
+    musicPlayer.feedBuffer();
+    uint32_t feed = micros() - t0;
+    feedTime += feed;
+    if (feed > maxFeed)
+      maxFeed = feed;
+  }
+  uint32_t elapsed = millis() - start;
+  musicPlayer.stopPlaying();
+
+  vs1053_feedstats_t stats;
+  musicPlayer.getFeedStats(&stats);
+
+  // audio seconds played is the wall clock time since we fed in real time
+  float audioSeconds = elapsed / 1000.0;
+
+  Serial.print(fn); Serial.print(',');
+  Serial.print(burst); Serial.print(',');
+  Serial.print(stats.bytesFed); Serial.print(',');
+  Serial.print(elapsed); Serial.print(',');
+  Serial.print(elapsed ? (stats.bytesFed * 1000.0 / elapsed) : 0, 0);
+  Serial.print(',');
+  Serial.print(stats.feeds); Serial.print(',');
+  Serial.print(stats.underruns); Serial.print(',');
+  Serial.print(stats.maxReadTime); Serial.print(',');
+  Serial.print(stats.maxFeedInterval); Serial.print(',');
+  Serial.print(audioSeconds > 0 ? (feedTime / audioSeconds) : 0, 0);
+  Serial.print(',');
+  Serial.print(maxFeed); Serial.print(',');
+  // where the feed time went
+  Serial.print(stats.readTime); Serial.print(',');
+  Serial.print(stats.sdiTime); Serial.print(',');
+  Serial.print(stats.pollTime); Serial.print(',');
+  Serial.print(stats.mixTime); Serial.print(',');
+  Serial.print(stats.bytesFed ? (stats.sdiTransfers * 1024.0 / stats.bytesFed) : 0, 2);
+  Serial.print(',');
+  Serial.println(stats.sdiClock);
+}
@@ -0,0 +1,87 @@
+/***************************************************
+  This is an example for the Adafruit VS1053 Codec Breakout
+
+  Designed specifically to work with the Adafruit VS1053 Codec Breakout
+  ----> https://www.adafruit.com/products/1381
+
+  Adafruit invests time and resources providing this open source code,
+  please support Adafruit and open-source hardware by purchasing
+  products from Adafruit!
+
+  Written by Limor Fried/Ladyada for Adafruit Industries.
+  BSD license, all text above must be included in any redistribution
+ ****************************************************/
+
+// Plays tones synthesized on the fly as raw PCM, no SD card needed.
+// Samples are made a block at a time and pushed with playPCM(), and the
+// latency (audio queued in the VS1053) is printed so you can see how far
+// ahead of the speaker the synthesis runs.
+
+// include SPI and MP3 libraries
+#include <SPI.h>
+#include <Adafruit_VS1053.h>
+
+// These are the pins used for the breakout example
+#define BREAKOUT_RESET  9      // VS1053 reset pin (output)
+#define BREAKOUT_CS     10     // VS1053 chip select pin (output)
+#define BREAKOUT_DCS    8      // VS1053 Data/command select pin (output)
+// These are the pins used for the music maker shield
+#define SHIELD_RESET  -1      // VS1053 reset pin (unused!)
+#define SHIELD_CS     7      // VS1053 chip select pin (output)
+#define SHIELD_DCS    6      // VS1053 Data/command select pin (output)
+
+#define DREQ 3       // VS1053 Data request pin
+
+#define SAMPLE_RATE 22050
+#define BLOCK 64     // samples made at a time
+
+Adafruit_VS1053 musicPlayer =
+  // create breakout-example object!
+  Adafruit_VS1053(BREAKOUT_RESET, BREAKOUT_CS, BREAKOUT_DCS, DREQ);
+  // create shield-example object!
+  //Adafruit_VS1053(SHIELD_RESET, SHIELD_CS, SHIELD_DCS, DREQ);
+
+int16_t sine[256];
+int16_t block[BLOCK];
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Adafruit VS1053 PCM Streaming Test");
+
+  if (! musicPlayer.begin()) { // initialise the music player
+     Serial.println(F("Couldn't find VS1053, do you have the right pins defined?"));
+     while (1);
+  }
+  Serial.println(F("VS1053 found"));
+
+  // Set volume for left, right channels. lower numbers == louder volume!
+  musicPlayer.setVolume(20,20);
+
+  for (uint16_t i=0; i<256; i++)
+    sine[i] = 8000 * sin(i * 2 * PI / 256);
+
+  musicPlayer.startPCM(SAMPLE_RATE, 1);
+}
+
+// a C major scale, in Hz
+const uint16_t notes[] = { 262, 294, 330, 349, 392, 440, 494, 523 };
+
+void loop() {
+  for (uint8_t n=0; n<sizeof(notes)/sizeof(notes[0]); n++) {
+    // phase step through the table per sample, in 1/256ths of an entry
+    uint32_t step = (uint32_t)notes[n] * 256 * 256 / SAMPLE_RATE;
+    uint32_t phase = 0;
+
+    // half a second per note
+    for (uint32_t made=0; made < SAMPLE_RATE/2; made += BLOCK) {
+      for (uint8_t i=0; i<BLOCK; i++) {
+        block[i] = sine[(phase >> 8) & 0xFF];
+        phase += step;
+      }
+      // waits on DREQ, so this paces the loop to the sample rate
+      musicPlayer.playPCM(block, BLOCK);
+    }
+    Serial.print(notes[n]); Serial.print(F(" Hz, latency "));
+    Serial.print(musicPlayer.pcmLatency()); Serial.println(F(" us"));
+  }
+}
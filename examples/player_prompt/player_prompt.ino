@@ -0,0 +1,104 @@
+/***************************************************
+  This is an example for the Adafruit VS1053 Codec Breakout
+
+  Designed specifically to work with the Adafruit VS1053 Codec Breakout
+  ----> https://www.adafruit.com/products/1381
+
+  Adafruit invests time and resources providing this open source code,
+  please support Adafruit and open-source hardware by purchasing
+  products from Adafruit!
+
+  Written by Limor Fried/Ladyada for Adafruit Industries.
+  BSD license, all text above must be included in any redistribution
+ ****************************************************/
+
+// Mixes a beep into background music every few seconds, turning the music
+// down while it plays. Prompts are mixed into the data on its way to the
+// VS1053, so the music has to be a 16-bit PCM WAV file; copy one to the SD
+// card as /track001.wav. The time spent mixing is printed after each beep.
+// The beep takes 10K of RAM, so this needs more than an Uno has.
+
+// include SPI, MP3 and SD libraries
+#include <SPI.h>
+#include <Adafruit_VS1053.h>
+#include <SD.h>
+
+// These are the pins used for the breakout example
+#define BREAKOUT_RESET  9      // VS1053 reset pin (output)
+#define BREAKOUT_CS     10     // VS1053 chip select pin (output)
+#define BREAKOUT_DCS    8      // VS1053 Data/command select pin (output)
+// These are the pins used for the music maker shield
+#define SHIELD_RESET  -1      // VS1053 reset pin (unused!)
+#define SHIELD_CS     7      // VS1053 chip select pin (output)
+#define SHIELD_DCS    6      // VS1053 Data/command select pin (output)
+
+// These are common pins between breakout and shield
+#define CARDCS 4     // Card chip select pin
+// DREQ should be an Int pin, see http://arduino.cc/en/Reference/attachInterrupt
+#define DREQ 3       // VS1053 Data request, ideally an Interrupt pin
+
+Adafruit_VS1053_FilePlayer musicPlayer =
+  // create breakout-example object!
+  Adafruit_VS1053_FilePlayer(BREAKOUT_RESET, BREAKOUT_CS, BREAKOUT_DCS, DREQ, CARDCS);
+  // create shield-example object!
+  //Adafruit_VS1053_FilePlayer(SHIELD_RESET, SHIELD_CS, SHIELD_DCS, DREQ, CARDCS);
+
+// a square wave, about 880Hz for 1/8 second at 44.1kHz
+#define BEEP_CYCLE 50
+#define BEEP_LENGTH (BEEP_CYCLE * 110)
+int16_t beep[BEEP_LENGTH];
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Adafruit VS1053 Prompt Mixing Test");
+
+  if (! musicPlayer.begin()) { // initialise the music player
+     Serial.println(F("Couldn't find VS1053, do you have the right pins defined?"));
+     while (1);
+  }
+  Serial.println(F("VS1053 found"));
+
+  if (!SD.begin(CARDCS)) {
+    Serial.println(F("SD failed, or not present"));
+    while (1);  // don't do anything more
+  }
+
+  // Set volume for left, right channels. lower numbers == louder volume!
+  musicPlayer.setVolume(20,20);
+
+  // If DREQ is on an interrupt pin (on uno, #2 or #3) we can do background
+  // audio playing
+  musicPlayer.useInterrupt(VS1053_FILEPLAYER_PIN_INT);  // DREQ int
+
+  for (uint16_t i=0; i<BEEP_LENGTH; i++)
+    beep[i] = ((i % BEEP_CYCLE) < BEEP_CYCLE/2) ? 6000 : -6000;
+
+  // music down to a quarter while the beep plays, fading over 50ms
+  musicPlayer.setDucking(64, 50);
+
+  if (! musicPlayer.startPlayingFile("/track001.wav")) {
+    Serial.println(F("Could not open /track001.wav"));
+    while (1);
+  }
+}
+
+void loop() {
+  if (! musicPlayer.playingMusic) {
+    Serial.println(F("Done playing music"));
+    while (1) delay(10);
+  }
+
+  delay(5000);
+  musicPlayer.resetFeedStats();
+  if (! musicPlayer.playPrompt(beep, BEEP_LENGTH)) {
+    Serial.println(F("Can't mix into this track, is it 16-bit PCM?"));
+    return;
+  }
+  while (musicPlayer.prompting())
+    delay(10);
+
+  vs1053_feedstats_t stats;
+  musicPlayer.getFeedStats(&stats);
+  Serial.print(F("Beeped, mixing took "));
+  Serial.print(stats.mixTime); Serial.println(F(" us"));
+}
@@ -0,0 +1,113 @@
+/*************************************************** 
+  This is an example for the Adafruit VS1053 Codec Breakout
+
+  Designed specifically to work with the Adafruit VS1053 Codec Breakout 
+  ----> https://www.adafruit.com/products/1381
+
+  Adafruit invests time and resources providing this open source code, 
+  please support Adafruit and open-source hardware by purchasing 
+  products from Adafruit!
+
+  Written by Limor Fried/Ladyada for Adafruit Industries.  
+  BSD license, all text above must be included in any redistribution
+ ****************************************************/
+
+// WAV recording with the VS1053's own encoder, no plugin needed.
+// Hold a button on digital 7 down to record, let go to stop.
+// RECORD_ADPCM picks 4-bit IMA ADPCM, a quarter the size of PCM and
+// plenty for voice.
+
+// A mic or line-in connection is required. See page 13 of the
+// datasheet for wiring
+
+
+// include SPI, MP3 and SD libraries
+#include <SPI.h>
+#include <Adafruit_VS1053.h>
+#include <SD.h>
+
+// define the pins used
+#define RESET 9      // VS1053 reset pin (output)
+#define CS 10        // VS1053 chip select pin (output)
+#define DCS 8        // VS1053 Data/command select pin (output)
+#define CARDCS A0     // Card chip select pin
+#define DREQ 3       // VS1053 Data request, ideally an Interrupt pin
+
+#define REC_BUTTON 7
+
+#define RECORD_RATE 16000  // Hz
+#define RECORD_ADPCM true
+
+Adafruit_VS1053_FilePlayer musicPlayer = Adafruit_VS1053_FilePlayer(RESET, CS, DCS, DREQ, CARDCS);
+
+void setup() {
+  Serial.begin(9600);
+  Serial.println("Adafruit VS1053 WAV Recording Test");
+
+  // initialise the music player
+  if (!musicPlayer.begin()) {
+    Serial.println("VS1053 not found");
+    while (1);  // don't do anything more
+  }
+
+  musicPlayer.sineTest(0x44, 500);    // Make a tone to indicate VS1053 is working
+ 
+  if (!SD.begin(CARDCS)) {
+    Serial.println("SD failed, or not present");
+    while (1);  // don't do anything more
+  }
+  Serial.println("SD OK!");
+  
+  // Set volume for left, right channels. lower numbers == louder volume!
+  musicPlayer.setVolume(10,10);
+  
+  // when the button is pressed, record!
+  pinMode(REC_BUTTON, INPUT);
+  digitalWrite(REC_BUTTON, HIGH);
+  
+  // poll the recording from a timer, so nothing's lost if loop() is slow.
+  // Without it tick() does the polling
+  musicPlayer.useInterrupt(VS1053_FILEPLAYER_TIMER0_INT);
+}
+
+void loop() {
+  // keeps the recording moving from the VS1053 to the card
+  musicPlayer.tick();
+
+  if (!musicPlayer.recording() && !digitalRead(REC_BUTTON)) {
+    Serial.println("Begin recording");
+
+    // Check if the file exists already
+    char filename[15];
+    strcpy(filename, "RECORD00.WAV");
+    for (uint8_t i = 0; i < 100; i++) {
+      filename[6] = '0' + i/10;
+      filename[7] = '0' + i%10;
+      if (! SD.exists(filename)) {
+        break;
+      }
+    }
+    Serial.print("Recording to "); Serial.println(filename);
+    // mono from the microphone (for linein, pass in 'false')
+    if (! musicPlayer.startRecordingWAV(filename, RECORD_RATE, 1,
+                                        RECORD_ADPCM, true)) {
+       Serial.println("Couldn't open file to record!");
+       while (1);
+    }
+  }
+  if (musicPlayer.recording() && digitalRead(REC_BUTTON)) {
+    Serial.println("End recording");
+    // tick() saves what's left and fills in the WAV header
+    musicPlayer.stopRecording();
+    while (musicPlayer.recording())
+      musicPlayer.tick();
+
+    vs1053_recordstats_t stats;
+    musicPlayer.getRecordStats(&stats);
+    Serial.print(stats.bytesWritten); Serial.print(" bytes, ");
+    Serial.print(stats.overruns); Serial.print(" overruns, ");
+    Serial.print(stats.ringFull); Serial.print(" ring full, slowest write ");
+    Serial.print(stats.maxWriteTime); Serial.println(" us");
+    delay(1000);
+  }
+}
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Convert a VS1053 plugin into a PROGMEM table for applyPatch().
+
+Reads either an .img file, as used by loadPlugin() (a "P&H" header, then
+records of type, length, address and big endian data), or a VLSI .plg file
+(a C array in the compressed plugin format), and writes a C header holding
+the plugin in the compressed format, with runs of repeated words folded up.
+
+    python3 plugin2progmem.py v44k1q05.img > v44k1q05.h
+
+then in the sketch:
+
+    #include "v44k1q05.h"
+    musicPlayer.applyPatch(v44k1q05, V44K1Q05_SIZE);
+
+Plugins that are started by hand (like the Ogg encoder, which is started by
+startRecordOgg()) get their start address as NAME_START. Pass --start to
+have applyPatch() start the plugin itself by writing SCI_AIADDR instead.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+SCI_WRAM = 0x06
+SCI_WRAMADDR = 0x07
+SCI_AIADDR = 0x0A
+
+# .img record types: I, X and Y memory, then the start address
+IMG_OFFSETS = {0: 0x8000, 1: 0x0000, 2: 0x4000}
+IMG_EXEC = 3
+
+# a repeated word is only worth a run of its own from this many copies
+MIN_RLE = 3
+MAX_RUN = 0x7FFF
+
+
+def read_img(data):
+    """Return ([(register, [words])], start address or None) from an .img"""
+    if data[:3] != b"P&H":
+        raise ValueError("not a P&H plugin image")
+    writes = []
+    start = None
+    pos = 3
+    while pos < len(data):
+        rtype = data[pos]
+        if rtype > IMG_EXEC or pos + 5 > len(data):
+            raise ValueError("bad record at offset %d" % pos)
+        length = ((data[pos + 1] << 8) | data[pos + 2]) & ~1
+        addr = (data[pos + 3] << 8) | data[pos + 4]
+        pos += 5
+        if rtype == IMG_EXEC:
+            start = addr
+            break
+        body = data[pos:pos + length]
+        if len(body) != length:
+            raise ValueError("record at offset %d runs past the end" % pos)
+        pos += length
+        words = [(body[i] << 8) | body[i + 1] for i in range(0, length, 2)]
+        writes.append((SCI_WRAMADDR, [addr + IMG_OFFSETS[rtype]]))
+        writes.append((SCI_WRAM, words))
+    return writes, start
+
+
+def read_plg(text):
+    """Return ([(register, [words])], start address or None) from a .plg"""
+    # the array body is everything between the first pair of braces
+    match = re.search(r"\{(.*?)\}", re.sub(r"/\*.*?\*/|//[^\n]*", "", text,
+                                           flags=re.S), re.S)
+    if not match:
+        raise ValueError("no array found")
+    values = [int(v, 0) for v in re.findall(r"0[xX][0-9a-fA-F]+|\d+",
+                                            match.group(1))]
+    writes = []
+    start = None
+    i = 0
+    while i + 1 < len(values):
+        addr, n = values[i], values[i + 1]
+        i += 2
+        if n & 0x8000:
+            words = [values[i]] * (n & 0x7FFF)
+            i += 1
+        else:
+            words = values[i:i + n]
+            i += n
+        if addr == SCI_AIADDR and words:
+            start = words[-1]
+            continue
+        writes.append((addr, words))
+    return writes, start
+
+
+def compress(writes):
+    """Pack writes into the compressed plugin format, folding repeats"""
+    out = []
+    for addr, words in writes:
+        i = 0
+        while i < len(words):
+            # length of the repeat starting here
+            rep = 1
+            while (i + rep < len(words) and words[i + rep] == words[i] and
+                   rep < MAX_RUN):
+                rep += 1
+            if rep >= MIN_RLE:
+                out += [addr, 0x8000 | rep, words[i]]
+                i += rep
+                continue
+            # copy run up to the next repeat worth folding
+            j = i
+            while j < len(words) and j - i < MAX_RUN:
+                k = 1
+                while (j + k < len(words) and words[j + k] == words[j] and
+                       k < MIN_RLE):
+                    k += 1
+                if k >= MIN_RLE:
+                    break
+                j += 1
+            out += [addr, j - i] + words[i:j]
+            i = j
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("plugin", help=".img or .plg file to convert")
+    parser.add_argument("-n", "--name",
+                        help="array name, defaults to the file name")
+    parser.add_argument("--start", action="store_true",
+                        help="start the plugin from applyPatch()")
+    args = parser.parse_args()
+
+    with open(args.plugin, "rb") as f:
+        data = f.read()
+    if data[:3] == b"P&H":
+        writes, start = read_img(data)
+    else:
+        writes, start = read_plg(data.decode("latin-1"))
+
+    if args.start and start is not None:
+        writes.append((SCI_AIADDR, [start]))
+    table = compress(writes)
+
+    name = args.name or re.sub(r"\W", "_",
+                               os.path.splitext(os.path.basename(
+                                   args.plugin))[0])
+    if name[0].isdigit():
+        name = "plugin_" + name
+    out = sys.stdout
+    out.write("// Generated by plugin2progmem.py from %s\n"
+              % os.path.basename(args.plugin))
+    out.write("#pragma once\n#include <Arduino.h>\n\n")
+    out.write("#define %s_SIZE %d\n" % (name.upper(), len(table)))
+    if start is not None and not args.start:
+        out.write("#define %s_START 0x%04X\n" % (name.upper(), start))
+    out.write("\nconst uint16_t %s[%s_SIZE] PROGMEM = {\n" %
+              (name, name.upper()))
+    for i in range(0, len(table), 8):
+        out.write("  " + ", ".join("0x%04x" % w for w in table[i:i + 8]) +
+                  ",\n")
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()